@@ -0,0 +1,385 @@
+/*
+ * ara.c
+ *
+ *  Anytime repairing A* (ARA*): a route fast, then better ones while
+ *  time remains.
+ *
+ *  Each round is an A* search ordered by g(x) + w * h(x). With w > 1 it
+ *  heads for the goal greedily and stops once no open board's key is
+ *  below the goal's g(x); the route found then costs at most w times the
+ *  optimum. The next round lowers w, and rather than starting over it
+ *  carries everything learned so far: every board keeps the cheapest
+ *  g(x) found for it in any round, the open list is re-keyed for the new
+ *  weight, and boards improved after being closed in the last round (the
+ *  INCONS list) are reopened. A round with w = 1 proves its route optimal.
+ *
+ *  After every round the route is handed to the solver's callback with
+ *  a tighter bound than w alone gives: no route can beat the cheapest
+ *  g(x) + h(x) among the open and INCONS boards. The solver's time budget
+ *  covers the whole search, first round included: once it runs out, the
+ *  best route so far is the result, or SOLVER_TIMED_OUT if there is none
+ *  yet.
+ *
+ *  Open-list keys are g(x) + w * h(x) in ARA_WEIGHT_SCALE units, and
+ *  g(x) is queued in the same units, so the bucket queue's tie levels
+ *  (key minus g) still put the boards nearest the goal first.
+ */
+
+#include "game.h"
+#include "hashmap.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+
+/* Each round lowers w by at least this much (in ARA_WEIGHT_SCALE units). */
+#define ARA_WEIGHT_STEP     2
+
+/* Expansions between looks at the clock. */
+#define ARA_CLOCK_EVERY     64
+
+
+typedef struct
+{
+    hashmap_t          *best;           /* Board class code -> arena index of its cheapest node. */
+    unsigned int       *incons;         /* Arena indices of boards improved while closed. */
+    unsigned int        incons_count;
+    unsigned int        incons_capacity;
+    queue_object_t     *drained;        /* Scratch for re-keying the open list. */
+    unsigned int        drained_capacity;
+    unsigned int        weight;
+    unsigned long long  goal_class;
+    unsigned long long  deadline;       /* On the monotonic clock in nanoseconds, from the start; or 0. */
+    unsigned int        reported;       /* Cost of the last route handed to the callback. */
+    int                 expired;
+} ara_t;
+
+
+static
+unsigned long long
+now_ns(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1000000000ULL + now.tv_nsec;
+}
+
+
+/* The board's node, if it is still its class's cheapest. */
+static inline
+int
+is_current(ara_t *ara,
+           game_t *game,
+           board_t *board)
+{
+    board_t scratch;
+    unsigned long long class_code = get_state_code(board_class(game, board, &scratch));
+
+    return board->node_index == hashmap__get(ara->best, class_code, ARENA_NO_NODE);
+}
+
+
+/* Queue a board under the round's weight. Returns nonzero if out of room. */
+static inline
+int
+open_board(ara_t *ara,
+           game_t *game,
+           board_t *board,
+           unsigned int handle)
+{
+    unsigned int g_x = board->moves_from_start, h_x = board->h_x;
+    unsigned int key = g_x * ARA_WEIGHT_SCALE + ara->weight * h_x;
+    queue_t *open = game->priority_queue;
+
+    int error = (QUEUE_NO_HANDLE != handle && NULL != queue__find(open, handle))
+        ? queue__decrease_key(open, handle, board, key, g_x * ARA_WEIGHT_SCALE, h_x)
+        : queue__insert_indexed(open, handle, board, key, g_x * ARA_WEIGHT_SCALE, h_x);
+    if (0 != error) return -1;
+
+    STAT_ADD(SOLVER_STAT_PUSHES, 1);
+    STAT_PEAK(SOLVER_STAT_OPEN_PEAK, open->current_size);
+    return 0;
+}
+
+
+/* Queue handles are class ranks, when the open list is indexed by them. */
+static inline
+unsigned int
+handle_of(game_t *game,
+          unsigned long long class_rank)
+{
+    return (game->priority_queue->handles > 0) ? (unsigned int)class_rank : QUEUE_NO_HANDLE;
+}
+
+
+/* Generate every successor of a board, keeping those reached more cheaply than before.
+ *  Returns nonzero if out of memory. */
+static
+int
+expand_board(ara_t *ara,
+             game_t *game,
+             board_t *current_state)
+{
+    const layout_t *layout = &game->layout;
+    unsigned int empty = ~current_state->occupied;
+
+    board_images_t images;
+    board_images(game, &images, current_state);
+
+    for (unsigned int from = current_state->occupied; from; from &= from - 1) {
+        int i = __builtin_ctz(from);
+        int piece = piece_at(current_state, i);
+
+        for (unsigned int to = empty & layout->dest_mask[i]; to; to &= to - 1) {
+            int dest = __builtin_ctz(to);
+
+            board_t *new_state = spawn_successor(game, current_state, piece, i, dest);
+            if (NULL == new_state) return -1;
+            STAT_ADD(SOLVER_STAT_SUCCESSORS, 1);
+
+            unsigned long long class_rank = class_rank_after_move(layout, &images, new_state->rank,
+                                                                  piece, i, dest);
+            unsigned int known = hashmap__get(ara->best, class_rank, ARENA_NO_NODE);
+
+            if (ARENA_NO_NODE != known
+                    && ((board_t *)arena__at(game->nodes, known))->moves_from_start <= new_state->moves_from_start) {
+                STAT_ADD(SOLVER_STAT_DUPLICATES, 1);
+                arena__rollback(game->nodes);
+                continue;
+            }
+
+            if (0 != hashmap__put(ara->best, class_rank, new_state->node_index)) return -1;
+
+            /* Closed this round: it waits for the next one. */
+            if (hashset__contains(game->visited_boards, class_rank)) {
+                if (ara->incons_count == ara->incons_capacity) {
+                    unsigned int capacity = ara->incons_capacity ? 2 * ara->incons_capacity : 256;
+                    unsigned int *grown = realloc(ara->incons, capacity * sizeof(unsigned int));
+                    if (NULL == grown) return -1;
+
+                    STAT_ADD(SOLVER_STAT_BYTES, (capacity - ara->incons_capacity) * sizeof(unsigned int));
+                    ara->incons = grown;
+                    ara->incons_capacity = capacity;
+                }
+
+                ara->incons[ara->incons_count++] = new_state->node_index;
+                continue;
+            }
+
+            if (0 != open_board(ara, game, new_state, handle_of(game, class_rank))) return -1;
+        }
+    }
+
+    return 0;
+}
+
+
+/* The goal's cheapest g(x) so far, or DISTANCE_UNKNOWN. */
+static inline
+unsigned int
+goal_g(ara_t *ara,
+       game_t *game)
+{
+    unsigned int index = hashmap__get(ara->best, ara->goal_class, ARENA_NO_NODE);
+    if (ARENA_NO_NODE == index) return DISTANCE_UNKNOWN;
+
+    return ((board_t *)arena__at(game->nodes, index))->moves_from_start;
+}
+
+
+/* One round: expand boards in key order until none could improve the goal's.
+ *  Returns nonzero if out of memory. */
+static
+int
+improve_path(ara_t *ara,
+             game_t *game)
+{
+    for (;;) {
+        unsigned int goal_cost = goal_g(ara, game);
+        unsigned int min_key = queue__min_F(game->priority_queue);
+
+        if (QUEUE_NO_F == min_key) return 0;
+        if (DISTANCE_UNKNOWN != goal_cost && goal_cost * ARA_WEIGHT_SCALE <= min_key) return 0;
+
+        /* Any round may be cut short, the first one included. */
+        if (0 != ara->deadline
+                && 0 == game->expansions % ARA_CLOCK_EVERY && now_ns() >= ara->deadline) {
+            ara->expired = 1;
+            return 0;
+        }
+
+        queue_object_t queue_obj = queue__get_min(game->priority_queue);
+        board_t *current_state = queue_obj.item;
+        STAT_ADD(SOLVER_STAT_POPS, 1);
+
+        /* Without a rank index the open list keeps superseded entries. */
+        if (NULL == current_state || !is_current(ara, game, current_state)) continue;
+
+        board_t scratch;
+        if (hashset__insert(game->visited_boards, get_state_code(board_class(game, current_state, &scratch))) < 0)
+            return -1;
+
+        ++game->expansions;
+        if (0 != expand_board(ara, game, current_state)) return -1;
+    }
+}
+
+
+/* Empty the open list and the INCONS list into 'drained', keeping only
+ *  boards still their class's cheapest. Returns their least g(x) + h(x)
+ *  (DISTANCE_UNKNOWN if there are none), or -1 if out of memory. */
+static
+long
+drain_frontier(ara_t *ara,
+               game_t *game,
+               unsigned int *count)
+{
+    unsigned int needed = game->priority_queue->current_size + ara->incons_count;
+    unsigned int least = DISTANCE_UNKNOWN;
+
+    if (needed > ara->drained_capacity) {
+        queue_object_t *grown = realloc(ara->drained, needed * sizeof(queue_object_t));
+        if (NULL == grown) return -1;
+
+        STAT_ADD(SOLVER_STAT_BYTES, (needed - ara->drained_capacity) * sizeof(queue_object_t));
+        ara->drained = grown;
+        ara->drained_capacity = needed;
+    }
+
+    *count = 0;
+    while (game->priority_queue->current_size > 0) {
+        queue_object_t queue_obj = queue__get_min(game->priority_queue);
+        if (NULL == queue_obj.item || !is_current(ara, game, queue_obj.item)) continue;
+
+        board_t *board = queue_obj.item;
+        ara->drained[(*count)++] = queue_obj;
+        least = MIN(least, board->moves_from_start + board->h_x);
+    }
+
+    for (unsigned int n = 0; n < ara->incons_count; ++n) {
+        board_t *board = arena__at(game->nodes, ara->incons[n]);
+        if (!is_current(ara, game, board)) continue;
+
+        queue_object_t queue_obj = { .item = board };
+        ara->drained[(*count)++] = queue_obj;
+        least = MIN(least, board->moves_from_start + board->h_x);
+    }
+
+    ara->incons_count = 0;
+    return least;
+}
+
+
+/* Hand the route to the goal found so far to the solver's callback. */
+static
+solver_status_t
+report(ara_t *ara,
+       game_t *game,
+       solver_result_t *result)
+{
+    game->current_board_state = arena__at(game->nodes,
+                                          hashmap__get(ara->best, ara->goal_class, ARENA_NO_NODE));
+    if (NULL == game->anytime.on_solution) return SOLVER_OK;
+
+    solver_result_t found = *result;
+    memset(&found.stats, 0, sizeof(solver_stats_t));
+    found.expansions = game->expansions;
+    found.nodes = game->nodes->used;
+
+    solver_status_t status = record_solution(game, &found);
+    if (SOLVER_OK == status) game->anytime.on_solution(&found, game->anytime.context);
+    return status;
+}
+
+
+/* ARA*: Solve with an inflated heuristic, then tighten it round by round
+ *  until the route is proven optimal or the time budget runs out. */
+solver_status_t
+ara__solve(game_t *game,
+           solver_result_t *result)
+{
+    debug("\n-- Running anytime repairing A* for a quick solution...\n");
+
+    ara_t ara = {
+        .best = hashmap__create(1 << 10),
+        .weight = game->anytime.weight,
+        .reported = DISTANCE_UNKNOWN,
+    };
+    solver_status_t status = SOLVER_OUT_OF_MEMORY;
+    board_t *root = game->current_board_state;
+    board_t scratch;
+
+    if (NULL == ara.best) return SOLVER_OUT_OF_MEMORY;
+
+    ara.goal_class = get_state_code(board_class(game, &game->goal_board_state, &scratch));
+
+    unsigned long long root_class = get_state_code(board_class(game, root, &scratch));
+    if (0 != hashmap__put(ara.best, root_class, root->node_index)
+            || 0 != open_board(&ara, game, root, handle_of(game, root_class)))
+        goto done;
+
+    /* The optimum is at least h(x) of the start, and the first route over w. */
+    double lower = root->h_x;
+
+    /* The time budget runs from the start, so it bounds the first round too. */
+    if (0 != game->anytime.budget_ns)
+        ara.deadline = now_ns() + game->anytime.budget_ns;
+
+    for (;;) {
+        if (0 != improve_path(&ara, game)) goto done;
+
+        unsigned int cost = goal_g(&ara, game);
+        if (DISTANCE_UNKNOWN == cost) {
+            status = ara.expired ? SOLVER_TIMED_OUT : SOLVER_NO_SOLUTION;
+            goto done;
+        }
+
+        /* Refining was cut short. The route may have improved, and the optimum is still at least 'lower'. */
+        if (ara.expired) {
+            result->bound = (cost > 0) ? cost / lower : 1.0;
+            if (cost < ara.reported && SOLVER_OK != report(&ara, game, result)) goto done;
+            break;
+        }
+
+        unsigned int count;
+        long least = drain_frontier(&ara, game, &count);
+        if (least < 0) goto done;
+
+        lower = MAX(lower, (double)cost * ARA_WEIGHT_SCALE / ara.weight);
+        lower = MAX(lower, (double)MIN((unsigned int)least, cost));
+        result->bound = (cost > 0) ? cost / lower : 1.0;
+
+        debug("\n === Round with w = %.2f found a route of %u moves, within %.3f of optimal ===\n",
+              (double)ara.weight / ARA_WEIGHT_SCALE, cost, result->bound);
+
+        if (SOLVER_OK != report(&ara, game, result)) goto done;
+        ara.reported = cost;
+
+        if (ARA_WEIGHT_SCALE == ara.weight || 1.0 == result->bound) break;
+        if (0 != ara.deadline && now_ns() >= ara.deadline) break;
+
+        /* Lower w by a step, or further, to the bound already proven. */
+        unsigned int proven = (unsigned int)(result->bound * ARA_WEIGHT_SCALE);
+        ara.weight = (ara.weight - ARA_WEIGHT_STEP < proven) ? ara.weight - ARA_WEIGHT_STEP : proven;
+        if (ara.weight < ARA_WEIGHT_SCALE) ara.weight = ARA_WEIGHT_SCALE;
+
+        /* Re-key every open board for the new weight, and start a fresh closed set. */
+        hashset__clear(game->visited_boards);
+        for (unsigned int n = 0; n < count; ++n) {
+            board_t *board = ara.drained[n].item;
+            if (0 != open_board(&ara, game, board, handle_of(game, board_class(game, board, &scratch)->rank)))
+                goto done;
+        }
+    }
+
+    game->current_board_state = arena__at(game->nodes,
+                                          hashmap__get(ara.best, ara.goal_class, ARENA_NO_NODE));
+    status = SOLVER_OK;
+
+done:
+    hashmap__destroy(&ara.best);
+    free(ara.incons);
+    free(ara.drained);
+    return status;
+}
@@ -0,0 +1,79 @@
+/*
+ * arena.c
+ *
+ *  Implementation of the search node arena.
+ */
+
+#include "arena.h"
+#include "stats.h"
+
+#include <stdlib.h>
+
+
+arena_t *
+arena__create(unsigned int node_size)
+{
+    arena_t *arena = calloc(1, sizeof(arena_t));
+    if (NULL == arena) return NULL;
+
+    arena->node_size = node_size;
+    return arena;
+}
+
+
+void
+arena__destroy(arena_t **arena)
+{
+    if (NULL == arena || NULL == *arena) return;
+
+    for (unsigned int i = 0; i < (*arena)->chunk_count; ++i)
+        free((*arena)->chunks[i]);
+
+    free((*arena)->chunks);
+    free(*arena);
+    *arena = NULL;
+}
+
+
+void
+arena__reset(arena_t *arena)
+{
+    /* Every node is released at once; the chunks stay allocated for the next search. */
+    arena->used = 0;
+}
+
+
+void *
+arena__alloc(arena_t *arena,
+             unsigned int *index)
+{
+    unsigned int chunk = arena->used >> ARENA_CHUNK_SHIFT;
+
+    /* Only the first node of a chunk can find the chunk missing. */
+    if (chunk == arena->chunk_count) {
+        if (arena->chunk_count == arena->chunk_slots) {
+            unsigned int slots = arena->chunk_slots ? arena->chunk_slots << 1 : 16;
+            unsigned char **chunks = realloc(arena->chunks, slots * sizeof(unsigned char *));
+            if (NULL == chunks) return NULL;
+
+            arena->chunks = chunks;
+            arena->chunk_slots = slots;
+        }
+
+        arena->chunks[chunk] = malloc((size_t)ARENA_CHUNK_NODES * arena->node_size);
+        if (NULL == arena->chunks[chunk]) return NULL;
+        ++arena->chunk_count;
+        STAT_ADD(SOLVER_STAT_BYTES, (size_t)ARENA_CHUNK_NODES * arena->node_size);
+    }
+
+    if (NULL != index) *index = arena->used;
+    return arena__at(arena, arena->used++);
+}
+
+
+void
+arena__rollback(arena_t *arena)
+{
+    /* Give back the most recent node, e.g. a successor which was rejected. */
+    if (arena->used > 0) --arena->used;
+}
@@ -0,0 +1,66 @@
+/*
+ * arena.h
+ *
+ *  Definitions for a chunked bump allocator of fixed-size search nodes.
+ */
+
+#ifndef FOURKNIGHTS_ARENA_H
+#define FOURKNIGHTS_ARENA_H
+
+
+/* Nodes per chunk, as a power of two so an index splits with a shift and mask. */
+#define ARENA_CHUNK_SHIFT   12
+#define ARENA_CHUNK_NODES   (1U << ARENA_CHUNK_SHIFT)
+
+/* Index meaning 'no node', e.g. the parent of the starting board. */
+#define ARENA_NO_NODE       (~0U)
+
+typedef struct
+{
+    unsigned char **chunks;
+    unsigned int    chunk_count;     /* Chunks allocated so far (kept across resets). */
+    unsigned int    chunk_slots;     /* Length of the 'chunks' array. */
+    unsigned int    node_size;
+    unsigned int    used;            /* Nodes handed out since the last reset. */
+} arena_t;
+
+
+arena_t *
+arena__create(
+    unsigned int node_size
+);
+
+void
+arena__destroy(
+    arena_t **arena
+);
+
+void
+arena__reset(
+    arena_t *arena
+);
+
+void *
+arena__alloc(
+    arena_t *arena,
+    unsigned int *index
+);
+
+void
+arena__rollback(
+    arena_t *arena
+);
+
+
+/* Resolve a node index to its address. Kept inline since it is on every parent walk. */
+static inline
+void *
+arena__at(arena_t *arena,
+          unsigned int index)
+{
+    return arena->chunks[index >> ARENA_CHUNK_SHIFT]
+        + (index & (ARENA_CHUNK_NODES - 1)) * arena->node_size;
+}
+
+
+#endif   /* FOURKNIGHTS_ARENA_H */
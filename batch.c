@@ -0,0 +1,201 @@
+/*
+ * batch.c
+ *
+ *  Solving many puzzles at once across a pool of worker threads.
+ *
+ *  Instances are dealt out to the workers in contiguous blocks, each kept
+ *  in that worker's work-stealing deque. A worker drains its own block
+ *  and then steals from the others, so a few expensive instances don't
+ *  leave the rest of the pool idle. Every worker owns a solver context,
+ *  set up like the caller's prototype, and results land in the caller's
+ *  array at the instance's own index, so they come back in input order
+ *  however the work was shared.
+ */
+
+#include "fourknights.h"
+#include "deque.h"
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+typedef struct
+{
+    const solver_t          *prototype;
+    const solver_instance_t *instances;
+    solver_batch_result_t   *results;
+    solver_algorithm_t       algorithm;
+    deque_t                **deques;
+    unsigned int             workers;
+    atomic_uint              unclaimed;   /* Instances no worker has taken yet. */
+} batch_t;
+
+typedef struct
+{
+    batch_t     *batch;
+    unsigned int id;
+    pthread_t    thread;
+} worker_t;
+
+
+/* Take the next instance: our own newest first, otherwise the oldest of another worker.
+ *  Returns 0 once every instance has been claimed. */
+static
+int
+claim_instance(batch_t *batch,
+               unsigned int id,
+               unsigned int *task)
+{
+    while (atomic_load_explicit(&batch->unclaimed, memory_order_acquire) > 0) {
+        if (deque__pop(batch->deques[id], task)) goto claimed;
+
+        for (unsigned int k = 1; k < batch->workers; ++k) {
+            deque_t *victim = batch->deques[(id + k) % batch->workers];
+
+            int stolen;
+            while (-1 == (stolen = deque__steal(victim, task)));
+            if (stolen) goto claimed;
+        }
+
+        /* Everything left is mid-claim by someone else; let them finish. */
+        sched_yield();
+    }
+
+    return 0;
+
+claimed:
+    atomic_fetch_sub_explicit(&batch->unclaimed, 1, memory_order_acq_rel);
+    return 1;
+}
+
+
+static
+void *
+run_worker(void *argument)
+{
+    worker_t *worker = argument;
+    batch_t *batch = worker->batch;
+
+    /* A worker without a solver simply leaves its share to be stolen. */
+    solver_t *solver = solver__create_like(batch->prototype);
+    if (NULL == solver) return NULL;
+
+    unsigned int task;
+    while (claim_instance(batch, worker->id, &task)) {
+        solver_batch_result_t *out = &batch->results[task];
+        solver_result_t result;
+
+        out->status = solver__solve(solver,
+                                    batch->algorithm,
+                                    batch->instances[task].start,
+                                    batch->instances[task].goal,
+                                    &result);
+        out->expansions = result.expansions;
+        out->stats = result.stats;
+        if (SOLVER_OK != out->status || 0 == result.move_count) continue;
+
+        /* The solver reuses its move buffer, so keep a copy of this route. */
+        out->moves = malloc(result.move_count * sizeof(solver_move_t));
+        if (NULL == out->moves) {
+            out->status = SOLVER_OUT_OF_MEMORY;
+            continue;
+        }
+
+        memcpy(out->moves, result.moves, result.move_count * sizeof(solver_move_t));
+        out->move_count = result.move_count;
+    }
+
+    solver__destroy(&solver);
+    return NULL;
+}
+
+
+solver_status_t
+solver__solve_batch(const solver_t *prototype,
+                    const solver_instance_t *instances,
+                    unsigned int count,
+                    solver_algorithm_t algorithm,
+                    unsigned int threads,
+                    solver_batch_result_t *results)
+{
+    solver_status_t status = SOLVER_OUT_OF_MEMORY;
+
+    /* Anything never reached (e.g. every worker failed to start) reports as out of memory. */
+    for (unsigned int i = 0; i < count; ++i) {
+        results[i].status = SOLVER_OUT_OF_MEMORY;
+        results[i].expansions = 0;
+        results[i].move_count = 0;
+        results[i].moves = NULL;
+        memset(&results[i].stats, 0, sizeof(solver_stats_t));
+    }
+
+    if (0 == count) return SOLVER_OK;
+    if (0 == threads) threads = 1;
+    if (threads > count) threads = count;
+
+    batch_t batch = {
+        .prototype = prototype,
+        .instances = instances,
+        .results = results,
+        .algorithm = algorithm,
+        .workers = threads,
+    };
+    atomic_init(&batch.unclaimed, count);
+
+    worker_t *workers = calloc(threads, sizeof(worker_t));
+    batch.deques = calloc(threads, sizeof(deque_t *));
+    if (NULL == workers || NULL == batch.deques) goto cleanup;
+
+    /* Deal contiguous blocks, pushed backward so each owner pops them in order. */
+    for (unsigned int w = 0; w < threads; ++w) {
+        unsigned int first = (unsigned long long)count * w / threads;
+        unsigned int last = (unsigned long long)count * (w + 1) / threads;
+
+        batch.deques[w] = deque__create(last - first);
+        if (NULL == batch.deques[w]) goto cleanup;
+
+        for (unsigned int i = last; i > first; --i)
+            deque__push(batch.deques[w], i - 1);
+    }
+
+    /* The calling thread works as worker #0. */
+    unsigned int started = 1;
+    for (unsigned int w = 0; w < threads; ++w) {
+        workers[w].batch = &batch;
+        workers[w].id = w;
+    }
+    for (; started < threads; ++started)
+        if (0 != pthread_create(&workers[started].thread, NULL, run_worker, &workers[started]))
+            break;
+
+    run_worker(&workers[0]);
+
+    for (unsigned int w = 1; w < started; ++w)
+        pthread_join(workers[w].thread, NULL);
+
+    status = SOLVER_OK;
+
+cleanup:
+    if (NULL != batch.deques)
+        for (unsigned int w = 0; w < threads; ++w)
+            deque__destroy(&batch.deques[w]);
+
+    free(batch.deques);
+    free(workers);
+    return status;
+}
+
+
+void
+solver__release_batch(solver_batch_result_t *results,
+                      unsigned int count)
+{
+    for (unsigned int i = 0; i < count; ++i) {
+        free(results[i].moves);
+        results[i].moves = NULL;
+        results[i].move_count = 0;
+    }
+}
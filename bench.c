@@ -0,0 +1,511 @@
+/*
+ * bench.c
+ *
+ *  Benchmark harness: times each search over many solves of one puzzle.
+ *
+ *  Every solve is timed on its own against the monotonic clock, after
+ *  untimed warmup solves (which also build whatever tables a search
+ *  keeps between solves, such as the retrograde table). The report gives
+ *  the fastest, median and 99th-percentile solve and the work behind
+ *  each, as a table, CSV or JSON.
+ *
+ *  Given the CSV report of an earlier run as a baseline, each search's
+ *  median is compared with it. A search slower by more than the
+ *  threshold, or expanding a different number of boards, is flagged, and
+ *  the harness then exits with status 2.
+ */
+
+#include "fourknights.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+
+/* The searches which can be timed, in the order they are reported. */
+typedef struct
+{
+    const char *name;
+    solver_algorithm_t algorithm;
+} bench_search_t;
+
+static const bench_search_t searches[] = {
+    { "astar",      SOLVER_ASTAR      },
+    { "bnb",        SOLVER_BNB        },
+    { "retro",      SOLVER_RETRO      },
+    { "hda",        SOLVER_HDA        },
+    { "ida",        SOLVER_IDA        },
+    { "bidi",       SOLVER_BIDI       },
+    { "bidi-astar", SOLVER_BIDI_ASTAR },
+    { "ara",        SOLVER_ARA        },
+    { "sma",        SOLVER_SMA        },
+};
+#define SEARCH_COUNT  (sizeof(searches) / sizeof(searches[0]))
+
+typedef enum
+{
+    FORMAT_TEXT = 0,
+    FORMAT_CSV,
+    FORMAT_JSON
+} bench_format_t;
+
+/* One search's measurements, and how they compare with the baseline. */
+typedef struct
+{
+    const bench_search_t *search;
+    double       min_us;
+    double       median_us;
+    double       p99_us;
+    double       mean_us;
+    double       expansions_per_second;    /* At the median. */
+    unsigned int expansions;
+    unsigned int nodes;
+    unsigned int moves;
+    int          deterministic;            /* Expansions are the same on every run. */
+
+    int          has_baseline;
+    double       baseline_median_us;
+    unsigned int baseline_expansions;
+    int          regressed;
+} bench_row_t;
+
+
+/* Print command-line usage. */
+static
+void
+usage(const char *program)
+{
+    fprintf(stderr, "Usage: %s [-s solver[,solver...]] [-n runs] [-w warmup] [-q heap|bucket] [-f file]\n"
+                    "       %*s [-g] [-p knights] [-j threads] [-d microseconds] [-o text|csv|json]\n"
+                    "       %*s [-c baseline.csv [-t percent]]\n",
+            program, (int)strlen(program), "", (int)strlen(program), "");
+    fprintf(stderr, "  -s    Searches to time, in order (default: all but hda).\n");
+    fprintf(stderr, "        One of:");
+    for (unsigned int i = 0; i < SEARCH_COUNT; ++i)
+        fprintf(stderr, " %s", searches[i].name);
+    fprintf(stderr, "\n");
+    fprintf(stderr, "  -n    Timed solves per search (default: 1000).\n");
+    fprintf(stderr, "  -w    Untimed warmup solves per search (default: 100).\n");
+    fprintf(stderr, "  -q    Open-list implementation (default: heap).\n");
+    fprintf(stderr, "  -f    Time the puzzle drawn in a file, instead of the classic puzzle.\n");
+    fprintf(stderr, "  -g    Search on the board's precomputed state graph.\n");
+    fprintf(stderr, "  -p    Guide astar, ida and hda with pattern databases over groups of this many knights.\n");
+    fprintf(stderr, "  -j    Threads for hda (default: 1).\n");
+    fprintf(stderr, "  -d    Time ara may take, in microseconds (default: no limit).\n");
+    fprintf(stderr, "  -o    Report format (default: text).\n");
+    fprintf(stderr, "  -c    Compare medians (and the expansions of searches that repeat them) with an\n"
+                    "        earlier '-o csv' report, flagging regressions.\n");
+    fprintf(stderr, "  -t    Slowdown, in percent, that counts as a regression (default: 10).\n");
+}
+
+
+/* Turn a comma-separated '-s' argument into a list of searches.
+ *  Returns the number selected, or 0 if any name is unknown. */
+static
+unsigned int
+parse_searches(char *names,
+               const bench_search_t **selected,
+               unsigned int limit)
+{
+    unsigned int count = 0;
+
+    for (char *name = strtok(names, ","); NULL != name; name = strtok(NULL, ",")) {
+        unsigned int i = 0;
+        while (i < SEARCH_COUNT && 0 != strcmp(name, searches[i].name)) ++i;
+
+        if (i == SEARCH_COUNT || count == limit) return 0;
+        selected[count++] = &searches[i];
+    }
+
+    return count;
+}
+
+
+/* Load one puzzle drawn as the solver prints boards: the start board, a
+ *  blank line, then the goal board. Returns nonzero on any error. */
+static
+int
+load_puzzle(const char *path,
+            solver_board_t *board,
+            solver_instance_t *puzzle)
+{
+    FILE *file = fopen(path, "r");
+    if (NULL == file) {
+        fprintf(stderr, "Cannot open '%s'.\n", path);
+        return 1;
+    }
+
+    char text[1024];
+    size_t length = fread(text, 1, sizeof(text) - 1, file);
+    fclose(file);
+    text[length] = '\0';
+
+    solver_board_t goal_board;
+    const char *rest = solver__read_board(text, board, puzzle->start);
+    if (NULL != rest) rest = solver__read_board(rest, &goal_board, puzzle->goal);
+
+    if (NULL == rest || board->rows != goal_board.rows || board->columns != goal_board.columns) {
+        fprintf(stderr, "%s: expected a start board and a goal board, separated by a blank line.\n", path);
+        return 1;
+    }
+
+    /* A side may leave its later knights out of one board, but not of both. */
+    if (goal_board.knights_per_side > board->knights_per_side)
+        board->knights_per_side = goal_board.knights_per_side;
+    return 0;
+}
+
+
+static
+int
+compare_samples(const void *a,
+                const void *b)
+{
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+
+/* Time one search: 'warmup' solves untimed, then 'runs' timed ones.
+ *  Returns nonzero, with a message, if any solve fails. */
+static
+int
+measure(solver_t *solver,
+        const solver_instance_t *puzzle,
+        unsigned int runs,
+        unsigned int warmup,
+        double *samples,
+        bench_row_t *row)
+{
+    solver_result_t result;
+
+    for (unsigned int r = 0; r < warmup + runs; ++r) {
+        struct timespec start, end;
+
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        solver_status_t status = solver__solve(solver, row->search->algorithm,
+                                               puzzle->start, puzzle->goal, &result);
+        clock_gettime(CLOCK_MONOTONIC, &end);
+
+        if (SOLVER_OK != status) {
+            fprintf(stderr, "%s failed: %s\n", row->search->name, solver__status_message(status));
+            return 1;
+        }
+
+        if (r >= warmup)
+            samples[r - warmup] = (end.tv_sec - start.tv_sec) * 1e6
+                                + (end.tv_nsec - start.tv_nsec) / 1e3;
+    }
+
+    /* Every solve of a puzzle does the same work (see 'deterministic'), so
+     * the last one speaks for all. */
+    row->expansions = result.expansions;
+    row->nodes = result.nodes;
+    row->moves = result.move_count;
+
+    double total = 0;
+    for (unsigned int r = 0; r < runs; ++r) total += samples[r];
+    qsort(samples, runs, sizeof(double), compare_samples);
+
+    /* The 99th percentile is taken by nearest rank. */
+    row->min_us = samples[0];
+    row->median_us = (runs & 1) ? samples[runs / 2] : (samples[runs / 2 - 1] + samples[runs / 2]) / 2;
+    row->p99_us = samples[(99 * runs + 99) / 100 - 1];
+    row->mean_us = total / runs;
+    row->expansions_per_second = row->median_us > 0 ? row->expansions / (row->median_us / 1e6) : 0;
+    return 0;
+}
+
+
+/* Match each row with its search's line in a '-o csv' report.
+ *  Returns nonzero if the file cannot be read. */
+static
+int
+load_baseline(const char *path,
+              bench_row_t *rows,
+              unsigned int count,
+              double threshold)
+{
+    FILE *file = fopen(path, "r");
+    if (NULL == file) {
+        fprintf(stderr, "Cannot open the baseline '%s'.\n", path);
+        return 1;
+    }
+
+    char line[512];
+    while (NULL != fgets(line, sizeof(line), file)) {
+        char name[64];
+        unsigned int runs, expansions;
+        double min_us, median_us;
+
+        /* The header and anything else unexpected simply fail to match. */
+        if (5 != sscanf(line, "%63[^,],%u,%lf,%lf,%*f,%*f,%u", name, &runs, &min_us, &median_us, &expansions))
+            continue;
+
+        for (unsigned int i = 0; i < count; ++i) {
+            if (0 != strcmp(name, rows[i].search->name)) continue;
+
+            rows[i].has_baseline = 1;
+            rows[i].baseline_median_us = median_us;
+            rows[i].baseline_expansions = expansions;
+            rows[i].regressed = rows[i].median_us > median_us * (1 + threshold / 100)
+                             || (rows[i].deterministic && rows[i].expansions != expansions);
+        }
+    }
+
+    fclose(file);
+    return 0;
+}
+
+
+/* Median change against the baseline, in percent. */
+static
+double
+change_of(const bench_row_t *row)
+{
+    return row->baseline_median_us > 0
+        ? 100 * (row->median_us - row->baseline_median_us) / row->baseline_median_us
+        : 0;
+}
+
+
+static
+void
+report_text(const bench_row_t *rows,
+            unsigned int count,
+            unsigned int runs,
+            unsigned int warmup)
+{
+    printf("%u timed solves per search, after %u warmup solves. Times in microseconds.\n\n", runs, warmup);
+    printf("%-12s %10s %10s %10s %10s %11s %14s %8s %6s\n",
+           "Search", "Min", "Median", "p99", "Mean", "Expansions", "Expansions/s", "Nodes", "Moves");
+
+    for (unsigned int i = 0; i < count; ++i) {
+        const bench_row_t *row = &rows[i];
+
+        printf("%-12s %10.2f %10.2f %10.2f %10.2f %11u %14.0f %8u %6u",
+               row->search->name, row->min_us, row->median_us, row->p99_us, row->mean_us,
+               row->expansions, row->expansions_per_second, row->nodes, row->moves);
+
+        if (row->has_baseline) {
+            printf("   %+6.1f%% vs %.2f", change_of(row), row->baseline_median_us);
+            if (row->expansions != row->baseline_expansions)
+                printf(", expansions were %u", row->baseline_expansions);
+            if (row->regressed) printf("   REGRESSION");
+        }
+        printf("\n");
+    }
+}
+
+
+static
+void
+report_csv(const bench_row_t *rows,
+           unsigned int count,
+           unsigned int runs)
+{
+    printf("search,runs,min_us,median_us,p99_us,mean_us,expansions,expansions_per_sec,nodes,moves"
+           ",baseline_median_us,change_percent,regression\n");
+
+    for (unsigned int i = 0; i < count; ++i) {
+        const bench_row_t *row = &rows[i];
+
+        printf("%s,%u,%.3f,%.3f,%.3f,%.3f,%u,%.0f,%u,%u",
+               row->search->name, runs, row->min_us, row->median_us, row->p99_us, row->mean_us,
+               row->expansions, row->expansions_per_second, row->nodes, row->moves);
+
+        if (row->has_baseline)
+            printf(",%.3f,%.2f,%d\n", row->baseline_median_us, change_of(row), row->regressed);
+        else
+            printf(",,,\n");
+    }
+}
+
+
+static
+void
+report_json(const bench_row_t *rows,
+            unsigned int count,
+            unsigned int runs,
+            unsigned int warmup)
+{
+    printf("{\n  \"runs\": %u,\n  \"warmup\": %u,\n  \"results\": [", runs, warmup);
+
+    for (unsigned int i = 0; i < count; ++i) {
+        const bench_row_t *row = &rows[i];
+
+        printf("%s\n    { \"search\": \"%s\", \"min_us\": %.3f, \"median_us\": %.3f, \"p99_us\": %.3f, "
+               "\"mean_us\": %.3f, \"expansions\": %u, \"expansions_per_sec\": %.0f, \"nodes\": %u, \"moves\": %u",
+               i ? "," : "", row->search->name, row->min_us, row->median_us, row->p99_us, row->mean_us,
+               row->expansions, row->expansions_per_second, row->nodes, row->moves);
+
+        if (row->has_baseline)
+            printf(", \"baseline_median_us\": %.3f, \"change_percent\": %.2f, \"regression\": %s",
+                   row->baseline_median_us, change_of(row), row->regressed ? "true" : "false");
+        printf(" }");
+    }
+
+    printf("\n  ]\n}\n");
+}
+
+
+int
+main(int argc,
+     char **argv)
+{
+    solver_board_t board = { 3, 3, 2 };
+    solver_instance_t puzzle = {
+        .start = {
+            BLACK_1, EMPTY, BLACK_2,
+            EMPTY,   EMPTY, EMPTY,
+            WHITE_1, EMPTY, WHITE_2
+        },
+        .goal = {
+            WHITE_2, EMPTY, WHITE_1,
+            EMPTY,   EMPTY, EMPTY,
+            BLACK_2, EMPTY, BLACK_1
+        },
+    };
+
+    /* HDA* is left out by default: thread start-up dominates a puzzle this small. */
+    const bench_search_t *selected[16];
+    unsigned int selected_count = 0;
+    for (unsigned int i = 0; i < SEARCH_COUNT; ++i)
+        if (SOLVER_HDA != searches[i].algorithm) selected[selected_count++] = &searches[i];
+
+    queue_kind_t queue_kind = QUEUE_BINARY_HEAP;
+    bench_format_t format = FORMAT_TEXT;
+    const char *board_path = NULL;
+    const char *baseline_path = NULL;
+    long runs = 1000, warmup = 100, pattern_knights = 0, threads = 1;
+    long long budget_us = 0;
+    double threshold = 10;
+    int use_graph = 0;
+    int opt;
+    while (-1 != (opt = getopt(argc, argv, "s:n:w:q:f:gp:j:d:o:c:t:"))) {
+        switch (opt) {
+            case 's':
+                selected_count = parse_searches(optarg, selected, 16);
+                if (0 == selected_count) { usage(argv[0]); return 1; }
+                break;
+            case 'n':
+                runs = strtol(optarg, NULL, 10);
+                if (runs < 1) { usage(argv[0]); return 1; }
+                break;
+            case 'w':
+                warmup = strtol(optarg, NULL, 10);
+                if (warmup < 0) { usage(argv[0]); return 1; }
+                break;
+            case 'q':
+                if (0 == strcmp(optarg, "heap")) queue_kind = QUEUE_BINARY_HEAP;
+                else if (0 == strcmp(optarg, "bucket")) queue_kind = QUEUE_BUCKET;
+                else { usage(argv[0]); return 1; }
+                break;
+            case 'f':
+                board_path = optarg;
+                break;
+            case 'g':
+                use_graph = 1;
+                break;
+            case 'p':
+                pattern_knights = strtol(optarg, NULL, 10);
+                if (pattern_knights < 1) { usage(argv[0]); return 1; }
+                break;
+            case 'j':
+                threads = strtol(optarg, NULL, 10);
+                if (threads < 1) { usage(argv[0]); return 1; }
+                break;
+            case 'd':
+                budget_us = strtoll(optarg, NULL, 10);
+                if (budget_us < 1) { usage(argv[0]); return 1; }
+                break;
+            case 'o':
+                if (0 == strcmp(optarg, "text")) format = FORMAT_TEXT;
+                else if (0 == strcmp(optarg, "csv")) format = FORMAT_CSV;
+                else if (0 == strcmp(optarg, "json")) format = FORMAT_JSON;
+                else { usage(argv[0]); return 1; }
+                break;
+            case 'c':
+                baseline_path = optarg;
+                break;
+            case 't':
+                threshold = strtod(optarg, NULL);
+                if (threshold < 0) { usage(argv[0]); return 1; }
+                break;
+            default:
+                usage(argv[0]);
+                return 1;
+        }
+    }
+
+    if (NULL != board_path && 0 != load_puzzle(board_path, &board, &puzzle))
+        return 1;
+
+    solver_t *solver = solver__create_board(&board, queue_kind);
+    if (NULL == solver) {
+        fprintf(stderr, "Failed to create a solver for a %ux%u board with %u knights a side.\n",
+                board.rows, board.columns, board.knights_per_side);
+        return 1;
+    }
+    solver__set_threads(solver, (unsigned int)threads);
+    solver__set_anytime(solver, 3.0, (unsigned long long)budget_us, NULL, NULL);
+
+    if (0 != solver__set_pattern_groups(solver, (unsigned int)pattern_knights)) {
+        fprintf(stderr, "Pattern databases over %ld knights are too large for a %ux%u board.\n",
+                pattern_knights, board.rows, board.columns);
+        solver__destroy(&solver);
+        return 1;
+    }
+
+    solver_graph_t *graph = NULL;
+    if (use_graph) {
+        graph = solver__create_graph(&board);
+        if (NULL == graph) {
+            fprintf(stderr, "Failed to build the state graph for a %ux%u board with %u knights a side.\n",
+                    board.rows, board.columns, board.knights_per_side);
+            solver__destroy(&solver);
+            return 1;
+        }
+
+        solver__use_graph(solver, graph);
+    }
+
+    int status = 1;
+    bench_row_t rows[16] = { 0 };
+    double *samples = malloc(runs * sizeof(double));
+    if (NULL == samples) {
+        fprintf(stderr, "Failed to allocate %ld samples.\n", runs);
+        goto done;
+    }
+
+    for (unsigned int s = 0; s < selected_count; ++s) {
+        rows[s].search = selected[s];
+
+        /* HDA* threads race each other, and ARA* on a clock stops wherever
+         * the time runs out, so only their medians are compared. */
+        rows[s].deterministic = !(SOLVER_HDA == selected[s]->algorithm && threads > 1)
+                             && !(SOLVER_ARA == selected[s]->algorithm && budget_us > 0);
+        if (0 != measure(solver, &puzzle, runs, warmup, samples, &rows[s])) goto done;
+    }
+
+    if (NULL != baseline_path && 0 != load_baseline(baseline_path, rows, selected_count, threshold))
+        goto done;
+
+    switch (format) {
+        case FORMAT_TEXT: report_text(rows, selected_count, runs, warmup); break;
+        case FORMAT_CSV:  report_csv(rows, selected_count, runs);          break;
+        case FORMAT_JSON: report_json(rows, selected_count, runs, warmup); break;
+    }
+
+    status = 0;
+    for (unsigned int s = 0; s < selected_count; ++s)
+        if (rows[s].regressed) status = 2;
+
+done:
+    free(samples);
+    solver__destroy(&solver);
+    solver__destroy_graph(&graph);
+    return status;
+}
@@ -0,0 +1,282 @@
+/*
+ * bidi.c
+ *
+ *  Bidirectional search: one frontier grows from the start and another
+ *  from the goal until they meet.
+ *
+ *  Every knight move can be played in reverse, so the goal's side uses
+ *  the same move generation. Each step expands whichever side has the
+ *  smaller open list. Every board reached by both sides gives a complete
+ *  route, and the cheapest seen so far is kept. Meeting is not enough to
+ *  stop: the search ends once no route through the open lists can beat
+ *  that cost.
+ *
+ *  Without a heuristic both sides are uniform-cost searches. With one,
+ *  each side runs A* toward the other end (front-to-end).
+ */
+
+#include "game.h"
+#include "hashmap.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+
+#define BIDI_NO_ROUTE   (~0U)
+
+
+/* One direction of the search. */
+typedef struct
+{
+    queue_t        *open;
+    arena_t        *nodes;
+    board_t        *target;     /* The board at the far end, for h(x). */
+    hashmap_t      *reached;    /* Board rank -> arena index of its cheapest node. */
+    const char     *name;
+} bidi_side_t;
+
+
+/* The cheapest g(x) a side has reached a board with, or DISTANCE_UNKNOWN. */
+static inline
+unsigned int
+reached_g(bidi_side_t *side,
+          unsigned long long code)
+{
+    unsigned int index = hashmap__get(side->reached, code, ARENA_NO_NODE);
+    if (ARENA_NO_NODE == index) return DISTANCE_UNKNOWN;
+
+    return ((board_t *)arena__at(side->nodes, index))->moves_from_start;
+}
+
+
+/* Queue a side's starting board. */
+static
+int
+seed_side(const layout_t *layout,
+          bidi_side_t *side,
+          board_t *root,
+          int use_heuristic)
+{
+    unsigned int h_x = use_heuristic ? get_heuristic_to(layout, root, side->target) : 0;
+
+    if (NULL == side->reached || 0 != hashmap__put(side->reached, get_state_code(root), root->node_index)) return -1;
+    return queue__insert_indexed(side->open, (unsigned int)root->rank, root, h_x, 0, h_x);
+}
+
+
+/* Expand the cheapest board of one side, noting any cheaper meeting point.
+ *  Returns nonzero if that side's open list or arena ran out of room. */
+static
+int
+expand_side(game_t *game,
+            bidi_side_t *side,
+            bidi_side_t *other,
+            int use_heuristic,
+            unsigned int *best_cost,
+            unsigned long long *meeting_code)
+{
+    const layout_t *layout = &game->layout;
+    queue_object_t queue_obj = queue__get_min(side->open);
+    board_t *current_state = queue_obj.item;
+    unsigned int empty = ~current_state->occupied;
+
+    STAT_ADD(SOLVER_STAT_POPS, 1);
+
+    /* Without a rank index the open list keeps superseded entries; a board
+     * reached more cheaply since it was queued is skipped. */
+    if (current_state->node_index != hashmap__get(side->reached, get_state_code(current_state), ARENA_NO_NODE))
+        return 0;
+
+    ++game->expansions;
+    debug("\n === Expanded from the %s w/ Cost %u ===\n", side->name, queue_obj.F);
+    print_board(layout, current_state);
+
+    for (unsigned int from = current_state->occupied; from; from &= from - 1) {
+        int i = __builtin_ctz(from);
+        int piece = piece_at(current_state, i);
+
+        for (unsigned int to = empty & layout->dest_mask[i]; to; to &= to - 1) {
+            int dest = __builtin_ctz(to);
+            unsigned int g_x = current_state->moves_from_start + 1;
+            unsigned long long code = rank_after_move(layout, current_state, piece, i, dest);
+
+            STAT_ADD(SOLVER_STAT_SUCCESSORS, 1);
+
+            /* This side already reaches the board as cheaply. */
+            if (g_x >= reached_g(side, code)) {
+                STAT_ADD(SOLVER_STAT_DUPLICATES, 1);
+                continue;
+            }
+
+            board_t *new_state = spawn_successor_in(layout, side->nodes, current_state, piece, i, dest);
+            if (NULL == new_state) return -1;
+
+            /* Kept for either side, so the joined route's boards are like any other search's. */
+            new_state->h_x = heuristic_after_move(game, current_state, piece, i, dest);
+
+            if (0 != hashmap__put(side->reached, code, new_state->node_index)) return -1;
+
+            unsigned int h_x = use_heuristic ? get_heuristic_to(layout, new_state, side->target) : 0;
+            unsigned int f_x = g_x + h_x;
+            unsigned int handle = (unsigned int)new_state->rank;
+
+            int error = (NULL != queue__find(side->open, handle))
+                ? queue__decrease_key(side->open, handle, new_state, f_x, g_x, h_x)
+                : queue__insert_indexed(side->open, handle, new_state, f_x, g_x, h_x);
+            if (0 != error) return -1;
+
+            STAT_ADD(SOLVER_STAT_PUSHES, 1);
+            STAT_PEAK(SOLVER_STAT_OPEN_PEAK, side->open->current_size);
+
+            /* Reached from both ends: a complete route. */
+            unsigned int other_g = reached_g(other, code);
+            if (DISTANCE_UNKNOWN != other_g && g_x + other_g < *best_cost) {
+                *best_cost = g_x + other_g;
+                *meeting_code = code;
+                debug("\tThe searches meet here, with a route of %u moves.\n", *best_cost);
+            }
+        }
+    }
+
+    return 0;
+}
+
+
+/* Follow the goal side's links from the meeting point, replaying each move after the start side's route. */
+static
+solver_status_t
+join_routes(game_t *game,
+            bidi_side_t *forward,
+            bidi_side_t *backward,
+            unsigned long long meeting_code)
+{
+    game->current_board_state = arena__at(forward->nodes,
+                                          hashmap__get(forward->reached, meeting_code, ARENA_NO_NODE));
+    board_t *board = arena__at(backward->nodes,
+                               hashmap__get(backward->reached, meeting_code, ARENA_NO_NODE));
+
+    while (ARENA_NO_NODE != board->parent_index) {
+        board_t *next = arena__at(backward->nodes, board->parent_index);
+
+        int piece = 0;
+        while (board->square[piece] == next->square[piece]) ++piece;
+
+        board_t *new_state = spawn_successor(game, game->current_board_state, piece,
+                                             board->square[piece], next->square[piece]);
+        if (NULL == new_state) return SOLVER_OUT_OF_MEMORY;
+
+        game->current_board_state = new_state;
+        board = next;
+    }
+
+    return SOLVER_OK;
+}
+
+
+/* Prepare the goal side's open list and arena, reusing them across solves. */
+static
+int
+reset_reverse_side(game_t *game)
+{
+    if (NULL == game->reverse_nodes)
+        game->reverse_nodes = arena__create(sizeof(board_t));
+    else
+        arena__reset(game->reverse_nodes);
+
+    if (NULL != game->reverse_queue && game->queue_kind == game->reverse_queue->kind) {
+        queue__clear(game->reverse_queue);
+    } else {
+        queue__destroy(&game->reverse_queue);
+        game->reverse_queue = queue__create(1 << 22, game->queue_kind);
+    }
+
+    if (NULL == game->reverse_nodes || NULL == game->reverse_queue) return -1;
+    if (game->layout.state_count > DENSE_STATE_LIMIT) return 0;
+    return queue__index(game->reverse_queue, game->layout.state_count);
+}
+
+
+/* Bidirectional: Grow both frontiers until the best meeting point is proven optimal. */
+solver_status_t
+bidi__solve(game_t *game,
+            int use_heuristic)
+{
+    debug("\n-- Running bidirectional %s for best solution...\n",
+          use_heuristic ? "A* search" : "uniform-cost search");
+
+    if (0 != reset_reverse_side(game)) return SOLVER_OUT_OF_MEMORY;
+
+    bidi_side_t forward = {
+        .open = game->priority_queue,
+        .nodes = game->nodes,
+        .target = &game->goal_board_state,
+        .reached = hashmap__create(1 << 10),
+        .name = "start",
+    };
+    bidi_side_t backward = {
+        .open = game->reverse_queue,
+        .nodes = game->reverse_nodes,
+        .target = &game->initial_board_state,
+        .reached = hashmap__create(1 << 10),
+        .name = "goal",
+    };
+
+    solver_status_t status = SOLVER_OUT_OF_MEMORY;
+    unsigned int best_cost = BIDI_NO_ROUTE;
+    unsigned long long meeting_code = 0;
+
+    unsigned int goal_index;
+    board_t *goal = arena__alloc(backward.nodes, &goal_index);
+    if (NULL == goal) goto done;
+
+    *goal = game->goal_board_state;
+    goal->node_index = goal_index;
+
+    if (0 != seed_side(&game->layout, &forward, game->current_board_state, use_heuristic)
+            || 0 != seed_side(&game->layout, &backward, goal, use_heuristic))
+        goto done;
+
+    if (game->current_board_state->placement == goal->placement) {
+        best_cost = 0;
+        meeting_code = get_state_code(goal);
+    }
+
+    for (;;) {
+        unsigned int forward_F = queue__min_F(forward.open);
+        unsigned int backward_F = queue__min_F(backward.open);
+
+        /* An exhausted side has already seen every board the other could meet. */
+        if (QUEUE_NO_F == forward_F || QUEUE_NO_F == backward_F) break;
+
+        /*
+         * The cheapest route not yet found must leave one open list and
+         * enter the other. With a consistent heuristic neither side's
+         * minimum f(x) can overestimate it. Blind, it costs both
+         * minimum g(x) plus the move joining them.
+         */
+        unsigned int lower_bound = use_heuristic
+            ? MAX(forward_F, backward_F)
+            : forward_F + backward_F + 1;
+        if (best_cost <= lower_bound) break;
+
+        /* Grow the smaller frontier. */
+        int ahead = forward.open->current_size <= backward.open->current_size;
+        if (0 != expand_side(game,
+                             ahead ? &forward : &backward,
+                             ahead ? &backward : &forward,
+                             use_heuristic,
+                             &best_cost,
+                             &meeting_code))
+            goto done;
+    }
+
+    status = (BIDI_NO_ROUTE == best_cost)
+        ? SOLVER_NO_SOLUTION
+        : join_routes(game, &forward, &backward, meeting_code);
+
+done:
+    game->other_nodes = backward.nodes->used;
+    hashmap__destroy(&forward.reached);
+    hashmap__destroy(&backward.reached);
+    return status;
+}
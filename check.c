@@ -0,0 +1,463 @@
+/*
+ * check.c
+ *
+ *  Correctness checks for every search, run by 'make check'.
+ *
+ *  Random puzzles on 3x3, 3x4 and 4x4 boards (from a fixed seed, so every
+ *  run checks the same ones) are solved by each search with both open
+ *  lists, with and without the state graph, and in a batch. The
+ *  retrograde table is the reference: a search must find a route exactly
+ *  when it does, as short as its own, and every route must be legal move
+ *  by move. Then the edge cases: goals no route reaches, an SMA* budget
+ *  too small for the optimal route, and ARA*'s time budget.
+ *
+ *  Each failure is printed, and the program exits with status 1 if there
+ *  was any.
+ */
+
+#include "fourknights.h"
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+/* The searches cross-checked against the retrograde table. */
+typedef struct
+{
+    const char *name;
+    solver_algorithm_t algorithm;
+    unsigned int threads;
+} check_search_t;
+
+static const check_search_t searches[] = {
+    { "astar",      SOLVER_ASTAR,      1 },
+    { "bnb",        SOLVER_BNB,        1 },
+    { "hda",        SOLVER_HDA,        1 },
+    { "hda/3",      SOLVER_HDA,        3 },
+    { "ida",        SOLVER_IDA,        1 },
+    { "bidi",       SOLVER_BIDI,       1 },
+    { "bidi-astar", SOLVER_BIDI_ASTAR, 1 },
+    { "ara",        SOLVER_ARA,        1 },
+    { "sma",        SOLVER_SMA,        1 },
+};
+#define SEARCH_COUNT  (sizeof(searches) / sizeof(searches[0]))
+
+/* Boards the random puzzles are drawn on, and how many of each. */
+typedef struct
+{
+    solver_board_t board;
+    unsigned int   count;
+} check_board_t;
+
+static const check_board_t boards[] = {
+    { { 3, 3, 2 }, 40 },
+    { { 3, 4, 2 }, 40 },
+    { { 4, 4, 2 }, 20 },
+};
+#define BOARD_COUNT  (sizeof(boards) / sizeof(boards[0]))
+
+/* Guarini's puzzle on 3x4: 22 moves, and thousands of A* expansions. */
+static const char guarini[] = "BbC.\n....\nWwX.\n\nWwX.\n....\nBbC.\n";
+
+static unsigned int failures = 0;
+static unsigned int solves = 0;
+static unsigned int skipped = 0;
+
+
+static
+void
+fail(const char *format,
+     ...) __attribute__((format(printf, 1, 2)));
+
+static
+void
+fail(const char *format,
+     ...)
+{
+    va_list args;
+
+    va_start(args, format);
+    fprintf(stderr, "FAIL: ");
+    vfprintf(stderr, format, args);
+    fprintf(stderr, "\n");
+    va_end(args);
+    ++failures;
+}
+
+
+/* SplitMix64, so the puzzles are the same on every run and platform. */
+static
+unsigned long long
+next_random(unsigned long long *state)
+{
+    unsigned long long z = (*state += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+
+/* Whether a knight can jump between two squares of the board. */
+static
+int
+knight_move(const solver_board_t *board,
+            unsigned int from,
+            unsigned int to)
+{
+    int dr = (int)(from / board->columns) - (int)(to / board->columns);
+    int dc = (int)(from % board->columns) - (int)(to % board->columns);
+    return dr * dr + dc * dc == 5;
+}
+
+
+/* Scatter every knight over the squares a knight can move from. */
+static
+void
+random_board(const solver_board_t *board,
+             unsigned long long *seed,
+             board_space_state_t spaces[MAX_BOARD_SQUARES])
+{
+    unsigned int squares = board->rows * board->columns;
+    unsigned int usable[MAX_BOARD_SQUARES], count = 0;
+
+    for (unsigned int i = 0; i < squares; ++i) {
+        spaces[i] = EMPTY;
+        for (unsigned int j = 0; j < squares; ++j)
+            if (knight_move(board, i, j)) {
+                usable[count++] = i;
+                break;
+            }
+    }
+
+    /* A partial Fisher-Yates shuffle picks the squares. */
+    for (unsigned int k = 0; k < 2 * board->knights_per_side; ++k) {
+        unsigned int pick = k + next_random(seed) % (count - k);
+        unsigned int square = usable[pick];
+
+        usable[pick] = usable[k];
+        usable[k] = square;
+        spaces[square] = (board_space_state_t)(k + 1);
+    }
+}
+
+
+/* Play a route on the start board. Returns NULL if it is legal and ends
+ *  on the goal, or else what is wrong with it. */
+static
+const char *
+replay(const solver_board_t *board,
+       const solver_instance_t *puzzle,
+       const solver_move_t *moves,
+       unsigned int move_count)
+{
+    unsigned int squares = board->rows * board->columns;
+    board_space_state_t spaces[MAX_BOARD_SQUARES];
+    memcpy(spaces, puzzle->start, sizeof(spaces));
+
+    for (unsigned int m = 0; m < move_count; ++m) {
+        const solver_move_t *move = &moves[m];
+
+        if (move->from >= squares || move->to >= squares) return "a move leaves the board";
+        if (spaces[move->from] != move->knight) return "a move takes a knight from where it is not";
+        if (EMPTY != spaces[move->to]) return "a move lands on another knight";
+        if (!knight_move(board, move->from, move->to)) return "a move is not a knight's move";
+
+        spaces[move->to] = spaces[move->from];
+        spaces[move->from] = EMPTY;
+    }
+
+    return (0 == memcmp(spaces, puzzle->goal, squares * sizeof(board_space_state_t)))
+        ? NULL : "the route does not end on the goal";
+}
+
+
+/* Check one solve against the reference: the same status, and for a
+ *  route, a legal one of the reference's length. */
+static
+void
+expect(const char *label,
+       unsigned int instance,
+       const solver_board_t *board,
+       const solver_instance_t *puzzle,
+       solver_status_t reference,
+       unsigned int optimal,
+       solver_status_t status,
+       const solver_move_t *moves,
+       unsigned int move_count)
+{
+    ++solves;
+
+    if (status != reference) {
+        fail("%s on %ux%u #%u: %s, expected %s", label, board->rows, board->columns, instance,
+             solver__status_message(status), solver__status_message(reference));
+        return;
+    }
+    if (SOLVER_OK != status) return;
+
+    const char *error = replay(board, puzzle, moves, move_count);
+    if (NULL != error)
+        fail("%s on %ux%u #%u: %s", label, board->rows, board->columns, instance, error);
+    else if (move_count != optimal)
+        fail("%s on %ux%u #%u: %u moves, the optimum is %u", label, board->rows, board->columns,
+             instance, move_count, optimal);
+}
+
+
+/* Cross-check every search on a board's random puzzles, for one open list and with or without the graph. */
+static
+void
+check_board(const check_board_t *entry,
+            const solver_instance_t *puzzles,
+            const solver_status_t *reference,
+            const unsigned int *optimal,
+            queue_kind_t queue_kind,
+            const solver_graph_t *graph)
+{
+    const solver_board_t *board = &entry->board;
+    char label[64];
+
+    solver_t *solver = solver__create_board(board, queue_kind);
+    if (NULL == solver) {
+        fail("cannot create a solver for %ux%u", board->rows, board->columns);
+        return;
+    }
+    solver__use_graph(solver, graph);
+
+    for (unsigned int s = 0; s < SEARCH_COUNT; ++s) {
+        snprintf(label, sizeof(label), "%s (%s%s)", searches[s].name,
+                 QUEUE_BUCKET == queue_kind ? "bucket" : "heap", graph ? ", graph" : "");
+        solver__set_threads(solver, searches[s].threads);
+
+        for (unsigned int i = 0; i < entry->count; ++i) {
+            solver_result_t result;
+            solver_status_t status = solver__solve(solver, searches[s].algorithm,
+                                                   puzzles[i].start, puzzles[i].goal, &result);
+
+            /* IDA* may give up on a reachable goal, but only at its expansion cap. */
+            if (SOLVER_IDA == searches[s].algorithm && SOLVER_OK == reference[i]
+                    && SOLVER_NO_SOLUTION == status && result.expansions >= IDA_EXPANSION_LIMIT) {
+                ++skipped;
+                continue;
+            }
+
+            expect(label, i + 1, board, &puzzles[i], reference[i], optimal[i],
+                   status, result.moves, result.move_count);
+        }
+    }
+
+    /* A batch must agree with the solver it is configured like. */
+    solver_batch_result_t *results = calloc(entry->count, sizeof(solver_batch_result_t));
+    solver__set_threads(solver, 1);
+    if (NULL == results
+            || SOLVER_OK != solver__solve_batch(solver, puzzles, entry->count, SOLVER_ASTAR, 4, results)) {
+        fail("batch on %ux%u could not run", board->rows, board->columns);
+    } else {
+        snprintf(label, sizeof(label), "batch astar (%s%s)",
+                 QUEUE_BUCKET == queue_kind ? "bucket" : "heap", graph ? ", graph" : "");
+        for (unsigned int i = 0; i < entry->count; ++i)
+            expect(label, i + 1, board, &puzzles[i], reference[i], optimal[i],
+                   results[i].status, results[i].moves, results[i].move_count);
+        solver__release_batch(results, entry->count);
+    }
+
+    free(results);
+    solver__destroy(&solver);
+}
+
+
+/* Every search, on the random puzzles of every board. */
+static
+void
+check_random(void)
+{
+    unsigned long long seed = 0x436865636B4B6E74ULL;
+
+    for (unsigned int b = 0; b < BOARD_COUNT; ++b) {
+        const check_board_t *entry = &boards[b];
+        const solver_board_t *board = &entry->board;
+
+        solver_instance_t *puzzles = calloc(entry->count, sizeof(solver_instance_t));
+        solver_status_t *reference = calloc(entry->count, sizeof(solver_status_t));
+        unsigned int *optimal = calloc(entry->count, sizeof(unsigned int));
+        solver_t *retro = solver__create_board(board, QUEUE_BINARY_HEAP);
+        solver_graph_t *graph = solver__create_graph(board);
+
+        if (NULL == puzzles || NULL == reference || NULL == optimal || NULL == retro || NULL == graph) {
+            fail("cannot set up the %ux%u puzzles", board->rows, board->columns);
+        } else {
+            /* The retrograde table gives the exact distance, or proves there is no route. */
+            unsigned int reachable = 0;
+            for (unsigned int i = 0; i < entry->count; ++i) {
+                solver_result_t result;
+
+                random_board(board, &seed, puzzles[i].start);
+                random_board(board, &seed, puzzles[i].goal);
+                reference[i] = solver__solve(retro, SOLVER_RETRO, puzzles[i].start, puzzles[i].goal, &result);
+                optimal[i] = result.move_count;
+                reachable += (SOLVER_OK == reference[i]);
+
+                const char *error = (SOLVER_OK == reference[i])
+                    ? replay(board, &puzzles[i], result.moves, result.move_count) : NULL;
+                if (NULL != error) fail("retro on %ux%u #%u: %s", board->rows, board->columns, i + 1, error);
+            }
+
+            printf("%ux%u: %u puzzles, %u of them solvable\n",
+                   board->rows, board->columns, entry->count, reachable);
+
+            check_board(entry, puzzles, reference, optimal, QUEUE_BINARY_HEAP, NULL);
+            check_board(entry, puzzles, reference, optimal, QUEUE_BUCKET, NULL);
+            check_board(entry, puzzles, reference, optimal, QUEUE_BINARY_HEAP, graph);
+        }
+
+        solver__destroy_graph(&graph);
+        solver__destroy(&retro);
+        free(optimal);
+        free(reference);
+        free(puzzles);
+    }
+}
+
+
+/* The classic puzzle with the white knights' places swapped: no search may find a route. */
+static
+void
+check_unreachable(void)
+{
+    const solver_board_t board = { 3, 3, 2 };
+    const solver_instance_t puzzle = {
+        .start = { BLACK_1, EMPTY, BLACK_2, EMPTY, EMPTY, EMPTY, WHITE_1, EMPTY, WHITE_2 },
+        .goal  = { WHITE_1, EMPTY, WHITE_2, EMPTY, EMPTY, EMPTY, BLACK_1, EMPTY, BLACK_2 },
+    };
+
+    solver_t *solver = solver__create_board(&board, QUEUE_BINARY_HEAP);
+    if (NULL == solver) {
+        fail("cannot create a solver for 3x3");
+        return;
+    }
+
+    for (unsigned int s = 0; s < SEARCH_COUNT; ++s) {
+        solver_result_t result;
+
+        solver__set_threads(solver, searches[s].threads);
+        solver_status_t status = solver__solve(solver, searches[s].algorithm, puzzle.start, puzzle.goal, &result);
+        expect(searches[s].name, 0, &board, &puzzle, SOLVER_NO_SOLUTION, 0,
+               status, result.moves, result.move_count);
+    }
+
+    solver__destroy(&solver);
+}
+
+
+/* SMA* with fewer nodes than the optimal route has boards must say so
+ *  rather than return a longer route, and one node more must be enough. */
+static
+void
+check_sma_budget(void)
+{
+    const solver_board_t board = { 3, 3, 2 };
+    const solver_instance_t puzzle = {
+        .start = { BLACK_1, EMPTY, BLACK_2, EMPTY, EMPTY, EMPTY, WHITE_1, EMPTY, WHITE_2 },
+        .goal  = { WHITE_2, EMPTY, WHITE_1, EMPTY, EMPTY, EMPTY, BLACK_2, EMPTY, BLACK_1 },
+    };
+    const unsigned int optimal = 16;
+
+    solver_t *solver = solver__create_board(&board, QUEUE_BINARY_HEAP);
+    if (NULL == solver) {
+        fail("cannot create a solver for 3x3");
+        return;
+    }
+
+    const unsigned int budgets[] = { 2, 8, optimal };
+    for (unsigned int b = 0; b < sizeof(budgets) / sizeof(budgets[0]); ++b) {
+        solver_result_t result;
+
+        solver__set_memory_limit(solver, budgets[b]);
+        solver_status_t status = solver__solve(solver, SOLVER_SMA, puzzle.start, puzzle.goal, &result);
+        expect("sma under its depth", budgets[b], &board, &puzzle, SOLVER_OUT_OF_MEMORY, optimal,
+               status, result.moves, result.move_count);
+    }
+
+    solver_result_t result;
+    solver__set_memory_limit(solver, optimal + 1);
+    solver_status_t status = solver__solve(solver, SOLVER_SMA, puzzle.start, puzzle.goal, &result);
+    expect("sma at its depth", optimal + 1, &board, &puzzle, SOLVER_OK, optimal,
+           status, result.moves, result.move_count);
+
+    solver__destroy(&solver);
+}
+
+
+/* ARA*'s time budget covers its first round: with next to no time it
+ *  has no route to give, and with some it gives a legal one within the
+ *  bound it reports. */
+static
+void
+check_ara_deadline(void)
+{
+    solver_board_t board, goal_board;
+    solver_instance_t puzzle;
+
+    const char *rest = solver__read_board(guarini, &board, puzzle.start);
+    if (NULL == rest || NULL == solver__read_board(rest, &goal_board, puzzle.goal)) {
+        fail("cannot read Guarini's puzzle");
+        return;
+    }
+
+    solver_t *solver = solver__create_board(&board, QUEUE_BINARY_HEAP);
+    if (NULL == solver) {
+        fail("cannot create a solver for 3x4");
+        return;
+    }
+
+    solver_result_t result;
+    solver_status_t status = solver__solve(solver, SOLVER_RETRO, puzzle.start, puzzle.goal, &result);
+    unsigned int optimal = result.move_count;
+    if (SOLVER_OK != status) fail("retro on Guarini's puzzle: %s", solver__status_message(status));
+
+    /* Plain A* needs thousands of expansions here, far past one microsecond. */
+    solver__set_anytime(solver, 1.0, 1, NULL, NULL);
+    status = solver__solve(solver, SOLVER_ARA, puzzle.start, puzzle.goal, &result);
+    expect("ara with no time", 0, &board, &puzzle, SOLVER_TIMED_OUT, optimal,
+           status, result.moves, result.move_count);
+
+    const unsigned long long budgets[] = { 100, 1000, 10000, 0 };
+    for (unsigned int b = 0; b < sizeof(budgets) / sizeof(budgets[0]); ++b) {
+        solver__set_anytime(solver, 3.0, budgets[b], NULL, NULL);
+        status = solver__solve(solver, SOLVER_ARA, puzzle.start, puzzle.goal, &result);
+        ++solves;
+
+        if (SOLVER_TIMED_OUT == status && 0 != budgets[b]) continue;
+        if (SOLVER_OK != status) {
+            fail("ara in %lluus: %s", budgets[b], solver__status_message(status));
+            continue;
+        }
+
+        const char *error = replay(&board, &puzzle, result.moves, result.move_count);
+        if (NULL != error)
+            fail("ara in %lluus: %s", budgets[b], error);
+        else if (result.move_count < optimal || result.move_count > result.bound * optimal + 1e-9)
+            fail("ara in %lluus: %u moves, outside its bound %.3f of the optimum %u",
+                 budgets[b], result.move_count, result.bound, optimal);
+        else if (0 == budgets[b] && (result.move_count != optimal || 1.0 != result.bound))
+            fail("ara with no time limit: %u moves at bound %.3f, the optimum is %u",
+                 result.move_count, result.bound, optimal);
+    }
+
+    solver__destroy(&solver);
+}
+
+
+int
+main(void)
+{
+    check_random();
+    check_unreachable();
+    check_sma_budget();
+    check_ara_deadline();
+
+    printf("%u solves checked, %u failed; %u IDA* solves gave up at the expansion cap.\n",
+           solves, failures, skipped);
+    return failures ? 1 : 0;
+}
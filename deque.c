@@ -0,0 +1,105 @@
+/*
+ * deque.c
+ *
+ *  Implementation of the Chase-Lev work-stealing deque, following the
+ *  C11 formulation by Le, Pop, Cohen and Zappa Nardelli (PPoPP '13).
+ */
+
+#include "deque.h"
+
+#include <stdlib.h>
+
+
+deque_t *
+deque__create(unsigned int capacity)
+{
+    deque_t *deque = aligned_alloc(64, sizeof(deque_t));
+    if (NULL == deque) return NULL;
+
+    deque->tasks = calloc(capacity ? capacity : 1, sizeof(atomic_uint));
+    if (NULL == deque->tasks) {
+        free(deque);
+        return NULL;
+    }
+
+    atomic_init(&deque->top, 0);
+    atomic_init(&deque->bottom, 0);
+    deque->capacity = capacity;
+    return deque;
+}
+
+
+void
+deque__destroy(deque_t **deque)
+{
+    if (NULL == deque || NULL == *deque) return;
+
+    free((*deque)->tasks);
+    free(*deque);
+    *deque = NULL;
+}
+
+
+/* Owner only. Returns nonzero if the deque is full. */
+int
+deque__push(deque_t *deque,
+            unsigned int task)
+{
+    long b = atomic_load_explicit(&deque->bottom, memory_order_relaxed);
+    long t = atomic_load_explicit(&deque->top, memory_order_acquire);
+    if (b - t >= (long)deque->capacity) return -1;
+
+    atomic_store_explicit(&deque->tasks[b % deque->capacity], task, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    atomic_store_explicit(&deque->bottom, b + 1, memory_order_relaxed);
+    return 0;
+}
+
+
+/* Owner only. Returns 1 and the newest task, or 0 if the deque is empty. */
+int
+deque__pop(deque_t *deque,
+           unsigned int *task)
+{
+    long b = atomic_load_explicit(&deque->bottom, memory_order_relaxed) - 1;
+    atomic_store_explicit(&deque->bottom, b, memory_order_relaxed);
+    atomic_thread_fence(memory_order_seq_cst);
+    long t = atomic_load_explicit(&deque->top, memory_order_relaxed);
+
+    if (t > b) {
+        atomic_store_explicit(&deque->bottom, b + 1, memory_order_relaxed);
+        return 0;
+    }
+
+    *task = atomic_load_explicit(&deque->tasks[b % deque->capacity], memory_order_relaxed);
+    if (t < b) return 1;
+
+    /* Last task: race any thief for it through 'top'. */
+    int won = atomic_compare_exchange_strong_explicit(&deque->top, &t, t + 1,
+                                                      memory_order_seq_cst,
+                                                      memory_order_relaxed);
+    atomic_store_explicit(&deque->bottom, b + 1, memory_order_relaxed);
+    return won;
+}
+
+
+/* Any thread. Returns 1 and the oldest task, 0 if the deque is empty,
+ * or -1 if another thread took that task first and it is worth retrying. */
+int
+deque__steal(deque_t *deque,
+             unsigned int *task)
+{
+    long t = atomic_load_explicit(&deque->top, memory_order_acquire);
+    atomic_thread_fence(memory_order_seq_cst);
+    long b = atomic_load_explicit(&deque->bottom, memory_order_acquire);
+
+    if (t >= b) return 0;
+
+    *task = atomic_load_explicit(&deque->tasks[t % deque->capacity], memory_order_relaxed);
+    if (!atomic_compare_exchange_strong_explicit(&deque->top, &t, t + 1,
+                                                 memory_order_seq_cst,
+                                                 memory_order_relaxed))
+        return -1;
+
+    return 1;
+}
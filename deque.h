@@ -0,0 +1,57 @@
+/*
+ * deque.h
+ *
+ *  Definitions for a work-stealing deque of task indices.
+ */
+
+#ifndef FOURKNIGHTS_DEQUE_H
+#define FOURKNIGHTS_DEQUE_H
+
+#include <stdatomic.h>
+
+
+/*
+ * A fixed-capacity Chase-Lev deque. Its owner pushes and pops at the
+ * bottom (LIFO) without contention, while any other thread may steal
+ * from the top (FIFO). 'top' and 'bottom' sit on separate cache lines
+ * so thieves polling one deque don't slow its owner down.
+ */
+typedef struct
+{
+    _Alignas(64) atomic_long top;
+    _Alignas(64) atomic_long bottom;
+    _Alignas(64) atomic_uint *tasks;
+    unsigned int capacity;
+} deque_t;
+
+
+deque_t *
+deque__create(
+    unsigned int capacity
+);
+
+void
+deque__destroy(
+    deque_t **deque
+);
+
+int
+deque__push(
+    deque_t *deque,
+    unsigned int task
+);
+
+int
+deque__pop(
+    deque_t *deque,
+    unsigned int *task
+);
+
+int
+deque__steal(
+    deque_t *deque,
+    unsigned int *task
+);
+
+
+#endif   /* FOURKNIGHTS_DEQUE_H */
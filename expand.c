@@ -0,0 +1,79 @@
+/*
+ * expand.c
+ *
+ *  Instances of the A* / branch and bound successor generator, and the
+ *  dispatcher which picks one for a solver.
+ */
+
+#include "game.h"
+
+
+/* The generic instance, for any board: everything comes from the layout. */
+#define EXPAND(name)              expand__generic_##name
+#define E_PIECES                  layout->pieces
+#define E_DEST_MASK(square)       layout->dest_mask[square]
+#define E_RANK_SLOT(square)       layout->rank_slot[square]
+#define E_RANK_WEIGHT(piece)      layout->rank_weight[piece]
+#define E_ZOBRIST(square, piece)  layout->zobrist_key[square][piece]
+#include "expand.h"
+#undef EXPAND
+#undef E_PIECES
+#undef E_DEST_MASK
+#undef E_RANK_SLOT
+#undef E_RANK_WEIGHT
+#undef E_ZOBRIST
+
+/* The same, reading successors from the game's state graph. */
+#define EXPAND(name)              expand__graph_##name
+#define E_GRAPH
+#define E_PIECES                  layout->pieces
+#define E_DEST_MASK(square)       layout->dest_mask[square]
+#define E_RANK_SLOT(square)       layout->rank_slot[square]
+#define E_RANK_WEIGHT(piece)      layout->rank_weight[piece]
+#define E_ZOBRIST(square, piece)  layout->zobrist_key[square][piece]
+#include "expand.h"
+#undef EXPAND
+#undef E_GRAPH
+#undef E_PIECES
+#undef E_DEST_MASK
+#undef E_RANK_SLOT
+#undef E_RANK_WEIGHT
+#undef E_ZOBRIST
+
+/* One instance per geometry in the Makefile's GEOMETRIES, with tables built in. */
+#include "geometries.h"
+
+
+static const struct
+{
+    unsigned int rows;
+    unsigned int columns;
+    unsigned int knights_per_side;
+    expand_fn    astar;
+    expand_fn    bnb;
+} specialized[] = {
+#define X(rows, columns, knights, tag) \
+    { rows, columns, knights, expand__##tag##_astar, expand__##tag##_bnb },
+    SPECIALIZED_GEOMETRIES(X)
+#undef X
+};
+
+
+expand_fn
+expand__select(game_t *game,
+               search_policy_t policy)
+{
+    const layout_t *layout = &game->layout;
+
+    if (NULL != game->graph)
+        return (POLICY_ASTAR == policy) ? expand__graph_astar : expand__graph_bnb;
+
+    for (unsigned int g = 0; g < sizeof(specialized) / sizeof(specialized[0]); ++g) {
+        if (specialized[g].rows == layout->rows
+                && specialized[g].columns == layout->columns
+                && specialized[g].knights_per_side == layout->knights_per_side)
+            return (POLICY_ASTAR == policy) ? specialized[g].astar : specialized[g].bnb;
+    }
+
+    return (POLICY_ASTAR == policy) ? expand__generic_astar : expand__generic_bnb;
+}
@@ -0,0 +1,314 @@
+/*
+ * expand.h
+ *
+ *  The successor generator shared by A* and branch and bound, written
+ *  once and instantiated for each board geometry.
+ *
+ *  This file has no include guard: it is meant to be included several
+ *  times, each time with these macros defined for one geometry.
+ *
+ *      EXPAND(name)               Name of each function instantiated.
+ *      E_PIECES                   Knights on the board.
+ *      E_DEST_MASK(square)        Knight moves from a square.
+ *      E_RANK_SLOT(square)        Ranking slot of a square.
+ *      E_RANK_WEIGHT(piece)       Ranking weight of a knight.
+ *      E_ZOBRIST(square, piece)   Zobrist key of a knight on a square.
+ *
+ *  The generic instance reads them from the game's layout. The ones in
+ *  geometries.h (generated at build time) expand to constants and static
+ *  tables, so every loop below has a fixed trip count. With E_GRAPH
+ *  defined, successors are read from the solver's precomputed state
+ *  graph instead of being generated.
+ *
+ *  The search policy is a constant argument of an always-inlined body,
+ *  so each policy gets a copy of its own without the other's branches.
+ *
+ *  The STAT_ and PHASE_ marks are the FN_STATS instrumentation (stats.h),
+ *  and TRACE the FN_TRACE event log (trace.h). Both vanish from other
+ *  builds.
+ */
+
+
+/* As rank_after_move() in game.h. */
+static inline __attribute__((always_inline))
+unsigned long long
+EXPAND(rank_after_move)(const layout_t *layout,
+                        board_t *board,
+                        int piece,
+                        int from,
+                        int to)
+{
+    int a = E_RANK_SLOT(from), b = E_RANK_SLOT(to);
+    long long delta = (b - a) * (long long)E_RANK_WEIGHT(piece);
+
+    for (int q = 0; q < (int)E_PIECES; ++q) {
+        int slot = E_RANK_SLOT(board->square[q]);
+
+        if (q < piece)
+            delta -= ((slot < b) - (slot < a)) * (long long)E_RANK_WEIGHT(piece);
+        else if (q > piece)
+            delta += ((a < slot) - (b < slot)) * (long long)E_RANK_WEIGHT(q);
+    }
+
+    return board->rank + delta;
+}
+
+
+/* As spawn_successor() in game.h, given the new board's rank. */
+static inline __attribute__((always_inline))
+board_t *
+EXPAND(spawn)(game_t *game,
+              board_t *current_state,
+              int piece,
+              int from,
+              int to,
+              unsigned long long rank)
+{
+    const layout_t *layout = &game->layout;
+    unsigned int new_index;
+
+    (void)layout;
+    PHASE_BEGIN(moves_timer);
+    board_t *new_state = arena__alloc(game->nodes, &new_index);
+    if (NULL == new_state) return NULL;
+
+    *new_state = *current_state;
+
+    new_state->square[piece] = to;
+    new_state->occupied ^= (1U << from) | (1U << to);
+    new_state->rank = rank;
+    new_state->hash ^= E_ZOBRIST(from, piece) ^ E_ZOBRIST(to, piece);
+
+    new_state->node_index = new_index;
+    new_state->parent_index = current_state->node_index;
+    new_state->moves_from_start = current_state->moves_from_start + 1;
+    PHASE_END(SOLVER_PHASE_MOVES, moves_timer);
+
+    PHASE_BEGIN(heuristic_timer);
+    new_state->h_x = heuristic_after_move(game, current_state, piece, from, to);
+    PHASE_END(SOLVER_PHASE_HEURISTIC, heuristic_timer);
+
+    STAT_ADD(SOLVER_STAT_SUCCESSORS, 1);
+    return new_state;
+}
+
+
+/* Queue one successor of the current board, unless it was seen already.
+ *  Returns nonzero if the open list ran out of room. */
+static inline __attribute__((always_inline))
+int
+EXPAND(consider)(game_t *game,
+                 search_policy_t policy,
+                 board_t *current_state,
+                 int piece,
+                 int i,
+                 int dest,
+                 unsigned long long rank,
+                 unsigned long long class_rank)
+{
+    const layout_t *layout = &game->layout;
+
+    (void)layout;
+
+    /* Create a new board state from the expansion. */
+    board_t *new_state = EXPAND(spawn)(game, current_state, piece, i, dest, rank);
+    if (NULL == new_state) return -1;
+
+    /* Make sure this new possible state has not already been visited.
+     * Rejected successors are handed straight back to the arena. */
+    PHASE_BEGIN(hash_timer);
+    int visited = hashset__contains(game->visited_boards, class_rank);
+    PHASE_END(SOLVER_PHASE_HASH, hash_timer);
+
+    if (0 != visited) {
+        STAT_ADD(SOLVER_STAT_DUPLICATES, 1);
+        TRACE(game->trace, TRACE_REJECT, (POLICY_ASTAR == policy) ? TRACE_ASTAR : 0, new_state,
+              0, new_state->moves_from_start, 0, 0);
+        arena__rollback(game->nodes);
+        return 0;
+    }
+
+    /*
+     * F(x) is the total cost estimate.
+     * G(x) is the amount of moves away from the origin for this expansion.
+     * H(x) is the heuristic (or 'closeness') measurement. It is not
+     * defined with branch and bound.
+     */
+    unsigned int h_x = (POLICY_ASTAR == policy) ? new_state->h_x : 0;
+    unsigned int g_x = new_state->moves_from_start;
+    unsigned int f_x = g_x + h_x;
+
+    /* A* only: a board already waiting in the open list keeps its
+     * entry unless this path reaches it more cheaply, in which case
+     * the entry is re-pointed at the new board and its key
+     * decreased in place. B&B never checks whether a sub-tree was
+     * already expanded. */
+    queue_object_t *open_entry = NULL;
+    if (POLICY_ASTAR == policy) {
+        PHASE_BEGIN(find_timer);
+        open_entry = queue__find(game->priority_queue, (unsigned int)class_rank);
+        PHASE_END(SOLVER_PHASE_QUEUE, find_timer);
+
+        if (NULL != open_entry && open_entry->G <= g_x) {
+            STAT_ADD(SOLVER_STAT_DUPLICATES, 1);
+            TRACE(game->trace, TRACE_REJECT, TRACE_ASTAR | TRACE_QUEUED, new_state,
+                  f_x, g_x, h_x, open_entry->G);
+            arena__rollback(game->nodes);
+            return 0;
+        }
+    }
+
+    if (POLICY_ASTAR == policy) {
+        if (NULL != open_entry) {
+            /* The superseded board stays in the arena until the next reset. */
+            TRACE(game->trace, TRACE_GENERATE, TRACE_ASTAR | TRACE_UPDATED, new_state,
+                  f_x, g_x, h_x, open_entry->G);
+
+            PHASE_BEGIN(decrease_timer);
+            int error = queue__decrease_key(game->priority_queue,
+                                            (unsigned int)class_rank,
+                                            new_state,
+                                            f_x,
+                                            g_x,
+                                            h_x);
+            PHASE_END(SOLVER_PHASE_QUEUE, decrease_timer);
+            STAT_ADD(SOLVER_STAT_PUSHES, 1);
+
+            return error ? -1 : 0;
+        }
+    }
+
+    /* Be sure to insert the board state into the priority-based queue structure. */
+    PHASE_BEGIN(insert_timer);
+    int error = queue__insert_indexed(game->priority_queue,
+                                      (POLICY_ASTAR == policy)
+                                          ? (unsigned int)class_rank
+                                          : QUEUE_NO_HANDLE,
+                                      new_state,
+                                      f_x,
+                                      g_x,
+                                      h_x);
+    PHASE_END(SOLVER_PHASE_QUEUE, insert_timer);
+
+    if (0 != error) {
+        arena__rollback(game->nodes);
+        return -1;
+    }
+
+    STAT_ADD(SOLVER_STAT_PUSHES, 1);
+    STAT_PEAK(SOLVER_STAT_OPEN_PEAK, game->priority_queue->current_size);
+    TRACE(game->trace, TRACE_GENERATE, (POLICY_ASTAR == policy) ? TRACE_ASTAR : 0, new_state,
+          f_x, g_x, h_x, 0);
+
+    /*
+     * Notice that A* doesn't track every board state as visited;
+     * only the ones it chooses from the min_queue. Instead, it can
+     * rely on the H(x) value to guide it to the end state that
+     * represents a completed game. B&B marks them as they appear.
+     */
+    if (POLICY_BNB == policy) {
+        PHASE_BEGIN(insert_hash_timer);
+        int added = hashset__insert(game->visited_boards, class_rank);
+        PHASE_END(SOLVER_PHASE_HASH, insert_hash_timer);
+        if (added < 0) return -1;
+    }
+
+    return 0;
+}
+
+
+/* Calculate a list of all possible next states from the current one.
+ *  Returns nonzero if the open list ran out of room. */
+static inline __attribute__((always_inline))
+int
+EXPAND(successors)(game_t *game,
+                   search_policy_t policy)
+{
+    /*
+     * Quick notes about the rules for Four Knights:
+     * - Squares with no knight moves (the middle space b2 on 3x3) are
+     *   never used as reachable locations.
+     * - Possible state transitions follow a map, but need to only
+     *   be allowed if the destination is EMPTY.
+     * - Knights can usually only ever move to two spaces from current.
+     */
+    board_t *current_state = game->current_board_state;
+
+    /* Successors are keyed by their class rank (see board_class()), worked
+     * out from this board's symmetric images rather than per successor. */
+    board_images_t images;
+    board_images(game, &images, current_state);
+
+    TRACE(game->trace, TRACE_EXPAND, 0, current_state,
+          current_state->moves_from_start + ((POLICY_ASTAR == policy) ? current_state->h_x : 0),
+          current_state->moves_from_start,
+          (POLICY_ASTAR == policy) ? current_state->h_x : 0,
+          game->expansions);
+
+#ifdef E_GRAPH
+    /* The graph lists the same moves in the same order, with their ranks. */
+    const graph_t *graph = game->graph;
+    unsigned int last = graph->offsets[current_state->rank + 1];
+
+    for (unsigned int e = graph->offsets[current_state->rank]; e < last; ++e) {
+        unsigned int move = graph->moves[e];
+        int piece = GRAPH_PIECE(move), from = GRAPH_FROM(move), to = GRAPH_TO(move);
+
+        PHASE_BEGIN(class_timer);
+        unsigned long long class_rank = class_rank_after_move(&game->layout, &images, graph->targets[e],
+                                                              piece, from, to);
+        PHASE_END(SOLVER_PHASE_HASH, class_timer);
+
+        if (0 != EXPAND(consider)(game, policy, current_state, piece, from, to,
+                                  graph->targets[e], class_rank))
+            return -1;
+    }
+#else
+    const layout_t *layout = &game->layout;
+    unsigned int empty = ~current_state->occupied;
+
+    (void)layout;
+
+    /* Walk the occupied squares in board order. */
+    for (unsigned int from = current_state->occupied; from; from &= from - 1) {
+        int i = __builtin_ctz(from);
+        int piece = piece_at(current_state, i);
+
+        /* For each occupied slot, the allowable destinations in the graph
+         * which are also EMPTY are the legal moves. */
+        for (unsigned int to = empty & E_DEST_MASK(i); to; to &= to - 1) {
+            int dest = __builtin_ctz(to);
+
+            PHASE_BEGIN(rank_timer);
+            unsigned long long rank = EXPAND(rank_after_move)(layout, current_state, piece, i, dest);
+            PHASE_END(SOLVER_PHASE_MOVES, rank_timer);
+
+            PHASE_BEGIN(class_timer);
+            unsigned long long class_rank = class_rank_after_move(&game->layout, &images, rank,
+                                                                  piece, i, dest);
+            PHASE_END(SOLVER_PHASE_HASH, class_timer);
+
+            if (0 != EXPAND(consider)(game, policy, current_state, piece, i, dest, rank, class_rank))
+                return -1;
+        }
+    }
+#endif
+
+    return 0;
+}
+
+
+static
+int
+EXPAND(astar)(game_t *game)
+{
+    return EXPAND(successors)(game, POLICY_ASTAR);
+}
+
+
+static
+int
+EXPAND(bnb)(game_t *game)
+{
+    return EXPAND(successors)(game, POLICY_BNB);
+}
@@ -0,0 +1,341 @@
+/*
+ * fourknights.h
+ *
+ *  Public interface of the Four Knights solver library.
+ *
+ *  A solver is an opaque, reusable search context. It owns its open list,
+ *  closed set, node arena and result buffer, so the allocations stay warm
+ *  from one solve to the next. Independent solvers share no mutable state
+ *  and may be used from different threads at the same time.
+ */
+
+#ifndef FOURKNIGHTS_H
+#define FOURKNIGHTS_H
+
+/* Limits on the boards a solver can take. */
+#define MAX_BOARD_SQUARES   32
+#define MAX_KNIGHTS         8
+
+/*
+ * SOLVER_IDA keeps no closed list, so it proves a goal unreachable only
+ * on boards where the knights can't pass one another, or from the
+ * retrograde table on boards with up to 2^22 states. Elsewhere, and on
+ * boards where revisiting states makes the search blow up, it gives up
+ * after this many expansions and reports SOLVER_NO_SOLUTION even though
+ * a route may exist. The other searches have no such limit.
+ */
+#define IDA_EXPANSION_LIMIT (1U << 22)
+
+/*
+ * What stands on a square. Larger boards number their knights on from
+ * these: with 'k' knights a side, black knights are 1..k and white
+ * knights are k+1..2k.
+ */
+typedef enum
+{
+    EMPTY = 0,
+    BLACK_1,
+    BLACK_2,
+    WHITE_1,
+    WHITE_2
+} board_space_state_t;
+
+/* Open-list implementations a solver can be created with. */
+typedef enum
+{
+    QUEUE_BINARY_HEAP = 0,
+    QUEUE_BUCKET
+} queue_kind_t;
+
+/* Board dimensions. Squares are numbered row by row from the top left. */
+typedef struct
+{
+    unsigned int rows;
+    unsigned int columns;
+    unsigned int knights_per_side;
+} solver_board_t;
+
+/* The searches a solver can run. */
+typedef enum
+{
+    SOLVER_ASTAR = 0,
+    SOLVER_BNB,
+    SOLVER_RETRO,
+    SOLVER_HDA,              /* A* spread over the solver's threads. */
+    SOLVER_IDA,              /* Iterative-deepening A*, in memory linear in the depth. */
+    SOLVER_BIDI,             /* Uniform-cost search from both ends at once. */
+    SOLVER_BIDI_ASTAR,       /* Front-to-end A* from both ends at once. */
+    SOLVER_ARA,              /* Anytime repairing A*: a quick route, refined while time remains. */
+    SOLVER_SMA               /* Memory-bounded A* (SMA*), within the solver's node budget. */
+} solver_algorithm_t;
+
+typedef enum
+{
+    SOLVER_OK = 0,
+    SOLVER_INVALID_BOARD,    /* A board is missing a knight, repeats one, or uses a square with no moves. */
+    SOLVER_NO_SOLUTION,      /* The goal cannot be reached from the start. */
+    SOLVER_OUT_OF_MEMORY,    /* The open list or another structure could not grow. */
+    SOLVER_TIMED_OUT         /* SOLVER_ARA's time budget ran out before it found any route. */
+} solver_status_t;
+
+/* One knight move of a solution, as square indices in board layout order. */
+typedef struct
+{
+    unsigned char knight;    /* The board_space_state_t of the knight moved. */
+    unsigned char from;
+    unsigned char to;
+} solver_move_t;
+
+/*
+ * What a solve did, counted only when the library is built with FN_STATS
+ * defined ('make stats'; see stats.h). Otherwise it is all zero.
+ */
+typedef enum
+{
+    SOLVER_STAT_SUCCESSORS = 0,    /* Boards generated. */
+    SOLVER_STAT_DUPLICATES,        /* Of those, dropped as visited or already queued as cheaply. */
+    SOLVER_STAT_PUSHES,            /* Open-list inserts and key decreases. */
+    SOLVER_STAT_POPS,              /* Open-list removals, stale entries included. */
+    SOLVER_STAT_OPEN_PEAK,         /* Most entries in one open list at once. */
+    SOLVER_STAT_BYTES,             /* Memory allocated for nodes, queues and tables. */
+    SOLVER_STAT_COUNT
+} solver_stat_t;
+
+/* Phases of A*, branch and bound and IDA* with their time measured. */
+typedef enum
+{
+    SOLVER_PHASE_MOVES = 0,        /* Making successor boards: copies, ranks and hashes. */
+    SOLVER_PHASE_HASH,             /* Closed-set keys and lookups. */
+    SOLVER_PHASE_HEURISTIC,        /* Updating h(x). */
+    SOLVER_PHASE_QUEUE,            /* Open-list operations. */
+    SOLVER_PHASE_COUNT
+} solver_phase_t;
+
+typedef struct
+{
+    unsigned long long counter[SOLVER_STAT_COUNT];
+    unsigned long long cycles[SOLVER_PHASE_COUNT];    /* TSC cycles on x86, else nanoseconds. */
+    unsigned long long calls[SOLVER_PHASE_COUNT];
+} solver_stats_t;
+
+typedef struct
+{
+    const solver_move_t *moves;    /* Owned by the solver; valid until its next solve. */
+    unsigned int move_count;
+    unsigned int expansions;
+    unsigned int nodes;            /* Boards the search allocated, in every arena it used. */
+    double bound;                  /* The route costs at most this many times the optimum (1: optimal). */
+    solver_stats_t stats;
+} solver_result_t;
+
+/* Called by SOLVER_ARA with each route it finds; 'result' is only valid during the call. */
+typedef void (*solver_solution_fn)(const solver_result_t *result, void *context);
+
+typedef struct _game solver_t;
+typedef struct _graph solver_graph_t;
+
+/* One puzzle of a batch. */
+typedef struct
+{
+    board_space_state_t start[MAX_BOARD_SQUARES];
+    board_space_state_t goal[MAX_BOARD_SQUARES];
+} solver_instance_t;
+
+typedef struct
+{
+    solver_status_t status;
+    unsigned int expansions;
+    unsigned int move_count;
+    solver_move_t *moves;    /* Released by solver__release_batch(). */
+    solver_stats_t stats;
+} solver_batch_result_t;
+
+
+/* A solver for the classic 3x3 puzzle. */
+solver_t *
+solver__create(
+    queue_kind_t queue_kind
+);
+
+/* A solver for any board within the limits above, or NULL if it is out of range. */
+solver_t *
+solver__create_board(
+    const solver_board_t *board,
+    queue_kind_t queue_kind
+);
+
+/*
+ * A fresh solver for the same board, with every setting of 'prototype'
+ * (open list, graph, threads, pattern groups, SOLVER_ARA and SOLVER_SMA
+ * settings) but none of its searches' state or its trace. Returns NULL
+ * if out of memory.
+ */
+solver_t *
+solver__create_like(
+    const solver_t *prototype
+);
+
+void
+solver__destroy(
+    solver_t **solver
+);
+
+/* Threads used by parallel searches such as SOLVER_HDA (default: 1). */
+void
+solver__set_threads(
+    solver_t *solver,
+    unsigned int threads
+);
+
+/*
+ * Guide the searches that use a heuristic (A*, IDA*, SOLVER_HDA,
+ * SOLVER_ARA and SOLVER_SMA) with additive pattern databases instead of
+ * per-knight distances: the knights are split into groups of 'knights'
+ * (rounded down to an even number above one, keeping each black knight
+ * with its white namesake), and each group's distance to its goal
+ * squares, ignoring the other knights, is tabulated for every placement.
+ * The tables are rebuilt whenever the goal changes. 0 (the default)
+ * turns them off. Returns nonzero, changing nothing, if a group's table
+ * would have more than 2^22 entries.
+ */
+int
+solver__set_pattern_groups(
+    solver_t *solver,
+    unsigned int knights
+);
+
+/*
+ * Settings of SOLVER_ARA: the weight on h(x) of its first round (default
+ * 3, rounded up to a quarter, at most 16; 1 makes it plain A*), and the
+ * time in microseconds the whole search may take (0, the default, for no
+ * limit). When it runs out the best route so far is the result, or
+ * SOLVER_TIMED_OUT if none was found yet. 'on_solution', if not NULL, is
+ * called with every route the search finds along the way and the bound
+ * proven for it.
+ */
+void
+solver__set_anytime(
+    solver_t *solver,
+    double weight,
+    unsigned long long budget_us,
+    solver_solution_fn on_solution,
+    void *context
+);
+
+/*
+ * Nodes SOLVER_SMA may keep at once (default 65536; values below 2 are
+ * raised to 2), allocated as the search needs them. Once they are all in
+ * use it forgets its least promising boards to make room, so it returns
+ * an optimal route whenever that route fits, and SOLVER_OUT_OF_MEMORY
+ * only when it cannot.
+ */
+void
+solver__set_memory_limit(
+    solver_t *solver,
+    unsigned int nodes
+);
+
+/*
+ * Precompute a board's whole state graph: every position, and the moves
+ * out of it. Returns NULL if the board has more than 2^22 positions or
+ * memory runs out. A graph is never modified, so any number of solvers
+ * (and threads) can share one.
+ */
+solver_graph_t *
+solver__create_graph(
+    const solver_board_t *board
+);
+
+void
+solver__destroy_graph(
+    solver_graph_t **graph
+);
+
+/*
+ * Have a solver read moves from a precomputed graph of its board instead
+ * of generating them (NULL to stop). The graph must outlive its use.
+ * Returns nonzero, changing nothing, if it was built for another board.
+ */
+int
+solver__use_graph(
+    solver_t *solver,
+    const solver_graph_t *graph
+);
+
+/*
+ * Log the solver's searches to a binary trace file at 'path' (NULL to
+ * stop), rendered as text by the fourknights-trace tool: every start,
+ * goal and route, and each board A* and branch and bound consider.
+ * Records are written out by a background thread and the file is
+ * complete once tracing stops or the solver is destroyed. Returns
+ * nonzero if the file can't be created, or if the library was built
+ * without FN_TRACE ('make trace'), which compiles tracing out.
+ */
+int
+solver__set_trace(
+    solver_t *solver,
+    const char *path
+);
+
+solver_status_t
+solver__solve(
+    solver_t *solver,
+    solver_algorithm_t algorithm,
+    const board_space_state_t *start,
+    const board_space_state_t *goal,
+    solver_result_t *result
+);
+
+/*
+ * Solve every instance across 'threads' workers, each with its own solver
+ * made by solver__create_like() from 'prototype', which is only read. A
+ * graph the prototype uses is shared by every worker, and a SOLVER_ARA
+ * callback is called from each worker's thread.
+ */
+solver_status_t
+solver__solve_batch(
+    const solver_t *prototype,
+    const solver_instance_t *instances,
+    unsigned int count,
+    solver_algorithm_t algorithm,
+    unsigned int threads,
+    solver_batch_result_t *results
+);
+
+void
+solver__release_batch(
+    solver_batch_result_t *results,
+    unsigned int count
+);
+
+/*
+ * Read a board drawn the way the debug output prints it: one character
+ * per square, '.' for empty, rows ending in a newline or '/'. Knights are
+ * lettered in pairs: black B b C c D d E e, white W w X x Y y Z z. A board
+ * ends at a space or tab, a blank line, or the end of the text.
+ *
+ * Fills 'spaces' and 'board' (the knights per side being the most any
+ * side uses), and returns the text after the board, or NULL if it is
+ * malformed or too large.
+ */
+const char *
+solver__read_board(
+    const char *text,
+    solver_board_t *board,
+    board_space_state_t spaces[MAX_BOARD_SQUARES]
+);
+
+/* The letter solver__read_board() uses for a knight. */
+char
+solver__knight_glyph(
+    const solver_board_t *board,
+    board_space_state_t knight
+);
+
+const char *
+solver__status_message(
+    solver_status_t status
+);
+
+
+#endif   /* FOURKNIGHTS_H */
@@ -0,0 +1,619 @@
+/*
+ * game.c
+ *
+ *  Board layouts, board encoding, and per-search setup shared by every solver.
+ */
+
+#include "game.h"
+
+
+/* The eight ways a knight can jump, as (row, column) steps. */
+static const int knight_step[8][2] = {
+    { -2, -1 }, { -2, 1 }, { -1, -2 }, { -1, 2 },
+    {  1, -2 }, {  1, 2 }, {  2, -1 }, {  2, 1 },
+};
+
+
+/* Walk the move graph's cycles and paths, for layouts where no square has more than two moves. */
+static
+void
+build_tracks(layout_t *layout)
+{
+    unsigned int seen = 0;
+
+    layout->narrow = 1;
+    for (unsigned int i = 0; i < layout->squares; ++i)
+        if (__builtin_popcount(layout->dest_mask[i]) > 2) layout->narrow = 0;
+
+    if (!layout->narrow) return;
+
+    unsigned int length = 0;
+    for (unsigned int i = 0; i < layout->squares; ++i) {
+        if (0 == layout->dest_mask[i] || (seen & (1U << i))) continue;
+
+        /* A path is walked from one of its ends; a cycle from anywhere. */
+        int start = i, is_cycle = 1;
+        for (unsigned int j = 0; j < layout->squares; ++j) {
+            if (layout->square_distance[i][j] == SQUARE_UNREACHABLE) continue;
+            if (1 == __builtin_popcount(layout->dest_mask[j])) {
+                start = j;
+                is_cycle = 0;
+                break;
+            }
+        }
+
+        layout->track_start[layout->track_count] = length;
+        layout->track_is_cycle[layout->track_count++] = is_cycle;
+
+        int previous = -1, current = start;
+        while (current >= 0 && !(seen & (1U << current))) {
+            seen |= (1U << current);
+            layout->track[length++] = current;
+
+            int next = -1;
+            for (unsigned int to = layout->dest_mask[current]; to; to &= to - 1)
+                if (__builtin_ctz(to) != previous) next = __builtin_ctz(to);
+
+            previous = current;
+            current = next;
+        }
+    }
+
+    layout->track_start[layout->track_count] = length;
+}
+
+
+/* Fill in every table of a layout for the given board. */
+int
+build_layout(layout_t *layout,
+             unsigned int rows,
+             unsigned int columns,
+             unsigned int knights_per_side)
+{
+    if (0 == rows || 0 == columns || rows * columns > MAX_BOARD_SQUARES
+            || 0 == knights_per_side || 2 * knights_per_side > MAX_KNIGHTS)
+        return 1;
+
+    memset(layout, 0, sizeof(layout_t));
+    layout->rows = rows;
+    layout->columns = columns;
+    layout->squares = rows * columns;
+    layout->knights_per_side = knights_per_side;
+    layout->pieces = 2 * knights_per_side;
+
+    /* The move graph: every knight jump that stays on the board. */
+    for (unsigned int i = 0; i < layout->squares; ++i) {
+        int r = i / columns, c = i % columns;
+
+        for (int k = 0; k < 8; ++k) {
+            int to_r = r + knight_step[k][0], to_c = c + knight_step[k][1];
+            if (to_r >= 0 && to_r < (int)rows && to_c >= 0 && to_c < (int)columns)
+                layout->dest_mask[i] |= (1U << (to_r * columns + to_c));
+        }
+    }
+
+    /* Square-to-square distances, one breadth-first search per square. */
+    memset(layout->square_distance, SQUARE_UNREACHABLE, sizeof(layout->square_distance));
+    for (unsigned int i = 0; i < layout->squares; ++i) {
+        unsigned char frontier[MAX_BOARD_SQUARES];
+        unsigned int head = 0, tail = 0;
+
+        layout->square_distance[i][i] = 0;
+        frontier[tail++] = i;
+        while (head < tail) {
+            int from = frontier[head++];
+
+            for (unsigned int to = layout->dest_mask[from]; to; to &= to - 1) {
+                int dest = __builtin_ctz(to);
+                if (SQUARE_UNREACHABLE != layout->square_distance[i][dest]) continue;
+
+                layout->square_distance[i][dest] = layout->square_distance[i][from] + 1;
+                frontier[tail++] = dest;
+            }
+        }
+    }
+
+    layout->slot_count = 0;
+    for (unsigned int i = 0; i < layout->squares; ++i) {
+        layout->rank_slot[i] = -1;
+        if (0 == layout->dest_mask[i]) continue;
+
+        layout->rank_slot[i] = layout->slot_count;
+        layout->slot_square[layout->slot_count++] = i;
+    }
+
+    if (layout->pieces > layout->slot_count) return 1;
+
+    /* Falling-factorial weights: 1, n-k+1, (n-k+1)(n-k+2), ... for the last knight first. */
+    layout->state_count = 1;
+    for (int p = layout->pieces - 1; p >= 0; --p) {
+        layout->rank_weight[p] = layout->state_count;
+        layout->state_count *= layout->slot_count - p;
+    }
+
+    /* Fill the Zobrist keys from a fixed-seed SplitMix64 stream so hashes
+     * (and therefore how HDA* shares out boards) are the same on every run. */
+    unsigned long long seed = 0x4B6E69676874735FULL;
+    for (unsigned int i = 0; i < layout->squares; ++i) {
+        for (unsigned int p = 0; p < layout->pieces; ++p) {
+            unsigned long long z = (seed += 0x9E3779B97F4A7C15ULL);
+            z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+            z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+            layout->zobrist_key[i][p] = z ^ (z >> 31);
+        }
+    }
+
+    /* Quarter turns (r, c) -> (c, rows - 1 - r), then optionally a mirror (r, c) -> (r, columns - 1 - c). */
+    for (int s = 0; s < SYMMETRY_COUNT; ++s) {
+        if ((s & 1) && rows != columns) continue;
+        layout->symmetries |= (1U << s);
+
+        for (unsigned int i = 0; i < layout->squares; ++i) {
+            int r = i / columns, c = i % columns;
+            int height = rows, width = columns;
+
+            for (int turn = 0; turn < (s & 3); ++turn) {
+                int t = r;
+                r = c;
+                c = height - 1 - t;
+
+                t = height;
+                height = width;
+                width = t;
+            }
+            if (s & 4) c = width - 1 - c;
+
+            layout->symmetry_square[s][i] = r * width + c;
+        }
+
+        /* BLACK_n and WHITE_n are pieces n - 1 and n - 1 + knights_per_side. */
+        for (unsigned int p = 0; p < layout->pieces; ++p)
+            layout->symmetry_piece[s][p] = (s & 8) ? (p + knights_per_side) % layout->pieces : p;
+    }
+
+    build_tracks(layout);
+    return 0;
+}
+
+
+/* Hash a board from scratch. Moves update it with two XORs instead. */
+unsigned long long
+hash_board(const layout_t *layout,
+           board_t *board)
+{
+    unsigned long long hash = 0;
+
+    for (unsigned int p = 0; p < layout->pieces; ++p)
+        hash ^= layout->zobrist_key[board->square[p]][p];
+
+    return hash;
+}
+
+
+/*
+ * Rank a board. Knight 'p' contributes the digit
+ *      slot(p) - #{ q < p : slot(q) < slot(p) },
+ * i.e. its slot counted among the slots not taken by earlier knights,
+ * which lies in [0, slot_count - p). The digits are mixed-radix, so
+ * every legal placement maps to a distinct index in [0, state_count).
+ */
+unsigned long long
+rank_board(const layout_t *layout,
+           board_t *board)
+{
+    unsigned long long rank = 0;
+
+    for (unsigned int p = 0; p < layout->pieces; ++p) {
+        int slot = layout->rank_slot[board->square[p]];
+        int digit = slot;
+
+        for (unsigned int q = 0; q < p; ++q)
+            if (layout->rank_slot[board->square[q]] < slot) --digit;
+
+        rank += digit * layout->rank_weight[p];
+    }
+
+    return rank;
+}
+
+
+/* Rebuild the placement and occupancy of a board from its rank. */
+void
+unrank_board(const layout_t *layout,
+             board_t *board,
+             unsigned long long rank)
+{
+    unsigned int taken = 0;
+
+    board->placement = ~0ULL;
+    board->occupied = 0;
+    board->rank = rank;
+
+    for (unsigned int p = 0; p < layout->pieces; ++p) {
+        int digit = (rank / layout->rank_weight[p]) % (layout->slot_count - p);
+
+        /* Take the digit'th slot not already used by an earlier knight. */
+        int slot = 0;
+        for (;; ++slot) {
+            if (taken & (1U << slot)) continue;
+            if (0 == digit--) break;
+        }
+
+        taken |= (1U << slot);
+        board->square[p] = layout->slot_square[slot];
+        board->occupied |= (1U << layout->slot_square[slot]);
+    }
+}
+
+
+/* Apply one symmetry to a board. Only the position fields are set. */
+void
+transform_board(const layout_t *layout,
+                board_t *out,
+                board_t *board,
+                unsigned int symmetry)
+{
+    out->placement = ~0ULL;
+    out->occupied = 0;
+
+    for (unsigned int p = 0; p < layout->pieces; ++p) {
+        int square = layout->symmetry_square[symmetry][board->square[p]];
+
+        out->square[layout->symmetry_piece[symmetry][p]] = square;
+        out->occupied |= (1U << square);
+    }
+
+    out->rank = rank_board(layout, out);
+    out->hash = hash_board(layout, out);
+}
+
+
+/* Find the lowest-ranked image of a board under a set of symmetries.
+ *  Stores it in 'out' and returns the symmetry that produced it. */
+unsigned int
+canonical_board(const layout_t *layout,
+                board_t *out,
+                board_t *board,
+                unsigned int symmetries)
+{
+    unsigned int best = 0;
+    board_t image;
+
+    *out = *board;
+    symmetries &= layout->symmetries;
+    for (unsigned int s = 1; s < SYMMETRY_COUNT; ++s) {
+        if (0 == (symmetries & (1U << s))) continue;
+
+        transform_board(layout, &image, board, s);
+        if (image.rank < out->rank) {
+            out->placement = image.placement;
+            out->occupied = image.occupied;
+            out->rank = image.rank;
+            out->hash = image.hash;
+            best = s;
+        }
+    }
+
+    return best;
+}
+
+
+/* Pack a square-by-square layout (as drawn in game.h) into a board.
+ *  Returns nonzero unless every knight appears exactly once on a square with moves. */
+int
+pack_board(const layout_t *layout,
+           board_t *board,
+           const board_space_state_t *spaces)
+{
+    unsigned int seen = 0;
+
+    board->placement = ~0ULL;
+    board->occupied = 0;
+    board->moves_from_start = 0;
+    board->node_index = ARENA_NO_NODE;
+    board->parent_index = ARENA_NO_NODE;
+
+    for (unsigned int i = 0; i < layout->squares; ++i) {
+        if (EMPTY == spaces[i]) continue;
+
+        int piece = PIECE_OF(spaces[i]);
+        if (piece < 0 || piece >= (int)layout->pieces || (seen & (1U << piece))
+                || layout->rank_slot[i] < 0)
+            return 1;
+
+        seen |= (1U << piece);
+        board->square[piece] = i;
+        board->occupied |= (1U << i);
+    }
+
+    if (seen != (1U << layout->pieces) - 1) return 1;
+
+    board->rank = rank_board(layout, board);
+    board->hash = hash_board(layout, board);
+    return 0;
+}
+
+
+/*
+ * Rule out goals that can never be reached, for searches with no closed
+ * list to run dry. Returns 0 only if the goal is certainly unreachable.
+ *
+ * Each knight has to stay in its own part of the move graph. And where the
+ * move graph is only cycles and paths (3x3 is one eight-square cycle),
+ * knights can't pass one another either, so the order they stand in along
+ * each one is fixed: exactly on a path or a full cycle, and up to
+ * rotation on a cycle with room to move.
+ */
+int
+goal_reachable(game_t *game)
+{
+    layout_t *layout = &game->layout;
+    board_t *start = game->current_board_state;
+    board_t *goal = &game->goal_board_state;
+
+    for (unsigned int p = 0; p < layout->pieces; ++p)
+        if (SQUARE_UNREACHABLE == layout->square_distance[start->square[p]][goal->square[p]])
+            return 0;
+
+    if (!layout->narrow) return 1;
+
+    for (unsigned int t = 0; t < layout->track_count; ++t) {
+        int start_order[MAX_KNIGHTS], goal_order[MAX_KNIGHTS];
+        unsigned int s = 0, g = 0;
+        unsigned int first = layout->track_start[t], last = layout->track_start[t + 1];
+
+        /* List the knights as they appear along the track. */
+        for (unsigned int i = first; i < last; ++i) {
+            for (unsigned int p = 0; p < layout->pieces; ++p) {
+                if (start->square[p] == layout->track[i]) start_order[s++] = p;
+                if (goal->square[p] == layout->track[i]) goal_order[g++] = p;
+            }
+        }
+
+        if (0 == s) continue;
+        int can_rotate = layout->track_is_cycle[t] && s < last - first;
+
+        /* Same order, up to where the listing happened to start if it may rotate. */
+        unsigned int r = 0;
+        for (; r < (can_rotate ? s : 1); ++r) {
+            unsigned int p = 0;
+            while (p < s && start_order[p] == goal_order[(p + r) % s]) ++p;
+            if (s == p) break;
+        }
+
+        if (r == (can_rotate ? s : 1)) return 0;
+    }
+
+    return 1;
+}
+
+
+/* Rewind the node arena to a lone copy of the start board, as a query
+ * that needs nothing more (the retrograde walk) does.
+ *  Returns nonzero if the arena could not be created. */
+int
+rewind_game(game_t *game)
+{
+    /* Every node of the previous search is released in one go. */
+    if (NULL == game->nodes)
+        game->nodes = arena__create(sizeof(board_t));
+    else
+        arena__reset(game->nodes);
+
+    if (NULL == game->nodes) return 1;
+
+    unsigned int root_index;
+    game->current_board_state = arena__alloc(game->nodes, &root_index);
+    if (NULL == game->current_board_state) return 1;
+
+    memcpy(game->current_board_state,
+           &game->initial_board_state,
+           sizeof(board_t));
+    game->current_board_state->node_index = root_index;
+
+    game->expansions = 0;
+    game->other_nodes = 0;
+    return 0;
+}
+
+
+/* Initialize a board state to its default for the puzzle.
+ *  Returns nonzero if the open list could not be created. */
+int
+reset_game(game_t *game)
+{
+    if (0 != rewind_game(game)) return 1;
+
+    /* h(x) is a sum of one term per knight, tabulated for this goal,
+     * or of one pattern-database entry per group of knights. */
+    for (unsigned int p = 0; p < game->layout.pieces; ++p)
+        for (unsigned int i = 0; i < game->layout.squares; ++i)
+            game->heuristic_term[p][i] =
+                game->layout.square_distance[i][game->goal_board_state.square[p]];
+    if (0 != pattern__build(game)) return 1;
+    game->current_board_state->h_x = get_heuristic(game->current_board_state, game);
+    game->goal_board_state.h_x = 0;
+
+    /* The symmetries a search may fold together are the ones fixing its goal. */
+    game->goal_symmetries = 1;
+    for (unsigned int s = 1; s < SYMMETRY_COUNT; ++s) {
+        if (0 == (game->layout.symmetries & (1U << s))) continue;
+
+        board_t image;
+        transform_board(&game->layout, &image, &game->goal_board_state, s);
+        if (image.placement == game->goal_board_state.placement)
+            game->goal_symmetries |= (1U << s);
+    }
+
+    /* Reuse the open list (and its already-committed storage) when possible. */
+    if (NULL != game->priority_queue && game->queue_kind == game->priority_queue->kind) {
+        queue__clear(game->priority_queue);
+    } else {
+        queue__destroy(&game->priority_queue);
+        game->priority_queue = queue__create(1 << 22, game->queue_kind);
+        if (NULL == game->priority_queue) return 1;
+    }
+
+    /* Open entries are indexed by board rank so A* can find and update them,
+     * as long as the board's state space is small enough to index. */
+    if (game->layout.state_count <= DENSE_STATE_LIMIT
+            && 0 != queue__index(game->priority_queue, game->layout.state_count))
+        return 1;
+
+    /* The closed set keeps its grown table between searches. */
+    if (NULL == game->visited_boards)
+        game->visited_boards = hashset__create(1 << 10);
+    else
+        hashset__clear(game->visited_boards);
+    if (NULL == game->visited_boards) return 1;
+
+    return 0;
+}
+
+
+/* Letter for knight 'piece': black B b C c D d E e, white W w X x Y y Z z. */
+static
+char
+glyph_of(unsigned int knights_per_side,
+         unsigned int piece)
+{
+    const char *letters = (piece < knights_per_side) ? "BCDE" : "WXYZ";
+    unsigned int i = piece % knights_per_side;
+
+    return (i & 1) ? letters[i / 2] - 'A' + 'a' : letters[i / 2];
+}
+
+
+/* Print the current board state. */
+void
+print_board(const layout_t *layout,
+            board_t *board)
+{
+    /* Lay the knights out over an empty board, indexed by piece number. */
+    char spaces[MAX_BOARD_SQUARES];
+
+    memset(spaces, '.', layout->squares);
+    for (unsigned int p = 0; p < layout->pieces; ++p)
+        spaces[board->square[p]] = glyph_of(layout->knights_per_side, p);
+
+    for (unsigned int i = 0; i < layout->squares; ++i) {
+        debug("%c", spaces[i]);
+        /* Print a line break at the end of each row. */
+        if (!((i + 1) % layout->columns)) debug("\n");
+    }
+}
+
+
+/* Print the series of moves discovered by the search. */
+void
+print_final_game_solution(game_t *game)
+{
+    debug("\n\n\n========================================\nFinal game route (%u steps):\n",
+           game->current_board_state->moves_from_start);
+
+    /* Create a linked list from the series of board states going backward. */
+    list__destroy(&game->solution_path, 0);
+    game->solution_path = list__create();
+
+    board_t *prev_board = game->current_board_state;
+    while (1) {
+        list__insert(game->solution_path, prev_board);
+        if (ARENA_NO_NODE == prev_board->parent_index) break;
+        prev_board = arena__at(game->nodes, prev_board->parent_index);
+    }
+
+    /* Reverse the list so it becomes a forward path. */
+    list__reverse(game->solution_path);
+
+    /* Traverse the list and print each board state. */
+    list_node_t *node = game->solution_path->head;
+    while (NULL != node) {
+        print_board(&game->layout, (board_t *)node->node);
+        debug("\n");
+        node = node->next;
+    }
+}
+
+
+char
+solver__knight_glyph(const solver_board_t *board,
+                     board_space_state_t knight)
+{
+    if (knight < 1 || knight > 2 * board->knights_per_side) return '?';
+    return glyph_of(board->knights_per_side, PIECE_OF(knight));
+}
+
+
+const char *
+solver__read_board(const char *text,
+                   solver_board_t *board,
+                   board_space_state_t spaces[MAX_BOARD_SQUARES])
+{
+    /* Knights are numbered per side until the side size is known. */
+    unsigned char side[MAX_BOARD_SQUARES], number[MAX_BOARD_SQUARES];
+    unsigned int squares = 0, rows = 0, columns = 0, row_length = 0, knights = 0;
+
+    while (' ' == *text || '\t' == *text || '\n' == *text || '\r' == *text) ++text;
+
+    for (;; ++text) {
+        char c = *text;
+        if ('\r' == c) continue;
+
+        if ('/' == c || '\n' == c || ' ' == c || '\t' == c || '\0' == c) {
+            if (row_length > 0) {
+                if (columns > 0 && columns != row_length) return NULL;
+                columns = row_length;
+                row_length = 0;
+                ++rows;
+            }
+
+            if ('/' == c) continue;
+
+            /* A newline only ends a row, unless a blank line follows. */
+            if ('\n' == c) {
+                const char *next = text + 1;
+                while ('\r' == *next) ++next;
+                if ('\n' != *next && '\0' != *next) continue;
+                ++text;
+            }
+            break;
+        }
+
+        if (squares == MAX_BOARD_SQUARES) return NULL;
+
+        side[squares] = 0;
+        number[squares] = 0;
+        if ('.' != c) {
+            const char *black = strchr("BCDEbcde", c), *white = strchr("WXYZwxyz", c);
+            if ('\0' == c || (NULL == black && NULL == white)) return NULL;
+
+            int letter = (NULL != black) ? black - "BCDEbcde" : white - "WXYZwxyz";
+            side[squares] = (NULL != black) ? 1 : 2;
+            number[squares] = 2 * (letter % 4) + (letter / 4);
+            knights = MAX(knights, number[squares] + 1U);
+        }
+
+        ++squares;
+        ++row_length;
+    }
+
+    if (0 == rows) return NULL;
+
+    /* A single line with no '/' has to be a square board. */
+    if (1 == rows) {
+        while (rows * rows < squares) ++rows;
+        if (rows * rows != squares) return NULL;
+        columns = rows;
+    }
+
+    board->rows = rows;
+    board->columns = columns;
+    board->knights_per_side = knights;
+
+    for (unsigned int i = 0; i < squares; ++i)
+        spaces[i] = (0 == side[i])
+            ? EMPTY
+            : (board_space_state_t)(1 + number[i] + (2 == side[i] ? knights : 0));
+
+    return text;
+}
@@ -10,14 +10,34 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include <math.h>
 
+#include "fourknights.h"
 #include "queue.h"
 #include "list.h"
+#include "hashset.h"
+#include "arena.h"
+#include "stats.h"
+#include "trace.h"
 
 
-#define BOARD_SIZE          9
-#define MAX_POSSIBLE_MOVES  2
+/* Distance-table entry for a state that cannot reach the goal. */
+#define DISTANCE_UNKNOWN    0xFFFF
+
+/* Square-distance entry for a square a knight can never reach. */
+#define SQUARE_UNREACHABLE  0xFF
+
+/* Pattern-database entry for a pattern that cannot reach the goal's. */
+#define PATTERN_UNREACHABLE 0xFF
+
+/* Board position of a knight slot that the layout doesn't use. */
+#define NO_SQUARE           0xFF
+
+/*
+ * Largest state space that gets arrays indexed by rank: the open-list
+ * index A* uses to update entries in place, and the retrograde table.
+ * Beyond it, searches keep their bookkeeping in hash tables keyed by rank.
+ */
+#define DENSE_STATE_LIMIT   (1ULL << 22)
 
 #define MIN(x,y) \
     ((x) < (y) ? (x) : (y))
@@ -34,18 +54,12 @@
 #define PRINT(x,...) \
     printf(x, ##__VA_ARGS__);
 
-/* This game uses a tri-state system for each space. */
-typedef enum
-{
-    EMPTY = 0,
-    BLACK_1,
-    BLACK_2,
-    WHITE_1,
-    WHITE_2
-} board_space_state_t;
+/* Knights are numbered by their space state, so BLACK_1 is piece #0. */
+#define PIECE_OF(state)     ((state) - 1)
+#define STATE_OF(piece)     ((board_space_state_t)((piece) + 1))
 
 /*
- * Board layout (0-indexed, so a1 = 0, a2 = 1, etc.):
+ * Board layout (0-indexed, so a1 = 0, a2 = 1, etc.), shown for 3x3:
  * +----+----+----+
  * | a1 | a2 | a3 |
  * +----+----+----+
@@ -53,84 +67,446 @@ typedef enum
  * +----+----+----+
  * | c1 | c2 | c3 |
  * +----+----+----+
+ *
+ * Boards are packed: each knight stores the index of the square it sits on,
+ * and the indices together form one 64-bit word (unused knights hold
+ * NO_SQUARE). Two boards are the same position exactly when their placement
+ * words are equal. The occupancy mask (bit N set when square N holds a
+ * knight) is kept alongside so move generation never has to scan the squares.
+ *
+ * Each board also carries its rank: a dense, collision-free index of the
+ * placement in [0, state_count). See rank_board() for the numbering.
+ * Within MAX_BOARD_SQUARES and MAX_KNIGHTS there are fewer than 2^39
+ * placements, so the rank always fits in 64 bits, and it is what
+ * duplicate detection keys on: two boards share a key only if they are
+ * the same position. Alongside it sits a 64-bit Zobrist hash, which only
+ * spreads boards over HDA* threads and labels trace records, where a
+ * collision costs nothing.
  */
 typedef struct _board board_t;
 struct _board {
+    unsigned long long hash;
     union {
-        struct {
-            board_space_state_t a1;
-            board_space_state_t a2;
-            board_space_state_t a3;
-            board_space_state_t b1;
-            board_space_state_t b2;
-            board_space_state_t b3;
-            board_space_state_t c1;
-            board_space_state_t c2;
-            board_space_state_t c3;
-        };
-        board_space_state_t s[BOARD_SIZE];
+        unsigned char      square[MAX_KNIGHTS];
+        unsigned long long placement;
     };
-    board_t *parent_state;
-    unsigned int moves_from_start;
+    unsigned long long rank;
+    unsigned int occupied;
+    unsigned short moves_from_start;
+    unsigned short h_x;           /* Heuristic estimate to the game's goal (see spawn_successor()). */
+    unsigned int node_index;      /* This board's slot in the game's node arena. */
+    unsigned int parent_index;    /* The board it was expanded from, or ARENA_NO_NODE. */
 };
 
 
-/* Meta-details about the current game. */
+/*
+ * Symmetries. Rotating or reflecting the board maps knight moves onto
+ * knight moves, and so does relabelling the knights. Symmetry 's' applies
+ * (s & 3) quarter turns and, when s & 4, a left-right mirror to every
+ * square, and when s & 8 swaps each black knight with the white knight
+ * of the same number. Symmetry 0 is the identity. Sets of symmetries are
+ * bitmasks over 's'. Quarter turns only exist on square boards.
+ */
+#define SYMMETRY_COUNT      16
+
+/*
+ * Everything fixed by the board's dimensions and knight count. A layout is
+ * built once per solver by build_layout() and is read-only afterwards.
+ */
+typedef struct
+{
+    unsigned int rows;
+    unsigned int columns;
+    unsigned int squares;
+    unsigned int knights_per_side;
+    unsigned int pieces;
+
+    /* Knight moves from each square, so 'empty & dest_mask[i]' yields every legal target. */
+    unsigned int dest_mask[MAX_BOARD_SQUARES];
+
+    /* Fewest knight moves between two squares on an empty board. */
+    unsigned char square_distance[MAX_BOARD_SQUARES][MAX_BOARD_SQUARES];
+
+    /*
+     * Ranking tables. Only squares with at least one move can ever hold a
+     * knight in a legal position, so those are renumbered densely as
+     * 'slots' (b2 has none on 3x3). rank_weight[p] is the number of ways
+     * to place the knights after 'p'.
+     */
+    signed char        rank_slot[MAX_BOARD_SQUARES];     /* Square -> slot, or -1. */
+    unsigned char      slot_square[MAX_BOARD_SQUARES];   /* Slot -> square. */
+    unsigned long long rank_weight[MAX_KNIGHTS];
+    unsigned int       slot_count;
+    unsigned long long state_count;
+
+    /* Zobrist keys: one random 64-bit value per (square, knight) pair. */
+    unsigned long long zobrist_key[MAX_BOARD_SQUARES][MAX_KNIGHTS];
+
+    unsigned int  symmetries;                  /* The ones this board has. */
+    unsigned char symmetry_square[SYMMETRY_COUNT][MAX_BOARD_SQUARES];
+    unsigned char symmetry_piece[SYMMETRY_COUNT][MAX_KNIGHTS];
+
+    /*
+     * When no square has more than two moves, the move graph is a set of
+     * separate cycles and paths, along which knights can never pass one
+     * another. 'track' lists the squares of each one in walking order.
+     */
+    int           narrow;
+    unsigned char track[MAX_BOARD_SQUARES];
+    unsigned char track_start[MAX_BOARD_SQUARES + 1];   /* Per component, into 'track'. */
+    unsigned char track_is_cycle[MAX_BOARD_SQUARES];
+    unsigned int  track_count;
+} layout_t;
+
+
+/*
+ * The whole state graph of a layout, precomputed: for each rank, its
+ * successors' ranks and the moves that lead there, in compressed sparse
+ * row form. The edges of rank 'r' are [offsets[r], offsets[r + 1]), listed
+ * in the order move generation would find them. It is read-only once
+ * built, so any number of solvers on the same board can share one.
+ */
+#define GRAPH_MOVE(piece, from, to)  (((piece) << 10) | ((from) << 5) | (to))
+#define GRAPH_PIECE(move)            ((move) >> 10)
+#define GRAPH_FROM(move)             (((move) >> 5) & 31)
+#define GRAPH_TO(move)               ((move) & 31)
+
+typedef struct _graph
+{
+    unsigned int        rows;
+    unsigned int        columns;
+    unsigned int        knights_per_side;
+    unsigned long long  state_count;
+    unsigned int        edge_count;
+    unsigned int       *offsets;     /* state_count + 1 entries. */
+    unsigned int       *targets;     /* Successor rank of each edge. */
+    unsigned short     *moves;       /* GRAPH_MOVE() of each edge. */
+} graph_t;
+
+
+/*
+ * Additive pattern databases (see pattern.c): the knights in disjoint
+ * groups, and for each group the fewest moves to the goal from any
+ * placement of its knights alone. A group's table is indexed by its
+ * knights' slots as base-slot_count digits, digit[p][square] being
+ * knight p's part of its group's index.
+ */
+typedef struct
+{
+    unsigned int        knights;                       /* Per group; 0 when not in use. */
+    unsigned int        group_count;
+    unsigned char       group_of[MAX_KNIGHTS];
+    unsigned char       member[MAX_KNIGHTS][MAX_KNIGHTS];
+    unsigned char       member_count[MAX_KNIGHTS];
+    unsigned int        digit[MAX_KNIGHTS][MAX_BOARD_SQUARES];
+    unsigned int        table_size[MAX_KNIGHTS];
+    unsigned char      *distance[MAX_KNIGHTS];         /* By group, then index. */
+    unsigned long long  goal_placement;                /* Goal the tables are for, once built. */
+    int                 built;
+} patterns_t;
+
+
+/*
+ * Settings of the anytime search (ara.c). Its weights on h(x) are kept in
+ * quarters, so the open-list keys stay small integers, as the bucket
+ * queue needs.
+ */
+#define ARA_WEIGHT_SCALE    4
+#define ARA_MAX_WEIGHT      16
+
+typedef struct
+{
+    unsigned int        weight;        /* First round's weight, in ARA_WEIGHT_SCALE units. */
+    unsigned long long  budget_ns;     /* Time the whole search may take; 0 for no limit. */
+    solver_solution_fn  on_solution;   /* Called with each route found, or NULL. */
+    void               *context;
+} anytime_t;
+
+
+/* Meta-details about the current game. This is the library's solver context. */
 typedef struct _game
 {
+    layout_t            layout;
+    const graph_t      *graph;                /* Precomputed state graph, or NULL. Not owned. */
     board_t            *current_board_state;
     board_t             initial_board_state;
     board_t             goal_board_state;
+    arena_t            *nodes;
     list_t             *solution_path;
-    list_t             *visited_boards;
+    hashset_t          *visited_boards;
+    unsigned short     *goal_distances;       /* Retrograde table, by rank. */
+    unsigned long long  goal_distances_rank;  /* Canonical goal the table was built for. */
+    unsigned int        goal_symmetries;      /* Symmetries leaving the goal as it is. */
+
+    /* Knight moves from each square to where each knight ends up: the
+     * terms of h(x), so a move changes it by exactly two lookups. */
+    unsigned char       heuristic_term[MAX_KNIGHTS][MAX_BOARD_SQUARES];
+    patterns_t          patterns;             /* Used instead, when configured. */
     queue_t            *priority_queue;
-//    queue_t            *visited_queue;
+    queue_t            *reverse_queue;        /* Bidirectional search: the goal's side. */
+    arena_t            *reverse_nodes;
+    queue_kind_t        queue_kind;
     unsigned int        expansions;
+    unsigned int        other_nodes;          /* Boards allocated outside 'nodes' (bidi, HDA*). */
+#ifdef FN_STATS
+    stats_block_t      *stats;                /* This solver's counters (see stats.h). */
+#endif
+#ifdef FN_TRACE
+    trace_t            *trace;                /* Event log, or NULL (see trace.h). */
+#endif
+    unsigned int        threads;              /* Threads a parallel search may use. */
+    struct _hda        *hda;                  /* HDA*'s worker pool, kept between solves (hda.c). */
+    anytime_t           anytime;
+    unsigned int        node_budget;          /* Most nodes SMA* keeps at once. */
+    solver_move_t      *moves;                /* Result buffer, reused across solves. */
+    unsigned int        move_capacity;
 } game_t;
 
 
-/* Create the set of legal game moves. */
-typedef struct { int destinations[2]; } move_t;
-static move_t move[BOARD_SIZE] = {
-        { .destinations = {5, 7} },
-        { .destinations = {6, 8} },
-        { .destinations = {3, 7} },
-        { .destinations = {2, 8} },
-        { .destinations = {-1, -1} }, /* #4 (b2) is unused. */
-        { .destinations = {0, 6} },
-        { .destinations = {1, 5} },
-        { .destinations = {0, 2} },
-        { .destinations = {1, 3} },
-};
+/*
+ * Fill a layout for a board of the given size. Returns nonzero if it is
+ * out of range (see MAX_BOARD_SQUARES and MAX_KNIGHTS).
+ */
+int
+build_layout(layout_t *layout,
+             unsigned int rows,
+             unsigned int columns,
+             unsigned int knights_per_side);
 
+unsigned long long
+hash_board(const layout_t *layout,
+           board_t *board);
 
-/* File-wide global game object. */
-static
-game_t *
-        four_knights;
+unsigned long long
+rank_board(const layout_t *layout,
+           board_t *board);
 
+void
+unrank_board(const layout_t *layout,
+             board_t *board,
+             unsigned long long rank);
+
+void
+transform_board(const layout_t *layout,
+                board_t *out,
+                board_t *board,
+                unsigned int symmetry);
+
+unsigned int
+canonical_board(const layout_t *layout,
+                board_t *out,
+                board_t *board,
+                unsigned int symmetries);
+
+int
+pack_board(const layout_t *layout,
+           board_t *board,
+           const board_space_state_t *spaces);
+
+int
+goal_reachable(game_t *game);
+
+int
+rewind_game(game_t *game);
+
+int
+reset_game(game_t *game);
+
+void
+print_board(const layout_t *layout,
+            board_t *board);
 
-/* Initialize a board state to its default for the puzzle. */
-static inline
 void
-reset_game(game_t *game)
+print_final_game_solution(game_t *game);
+
+/* How a best-first search treats the boards it generates. */
+typedef enum
 {
-    free(game->current_board_state);
-    game->current_board_state = (board_t *)malloc(sizeof(board_t));
+    POLICY_ASTAR = 0,    /* Guided by h(x); closes boards when selected, updates open ones. */
+    POLICY_BNB           /* No h(x); closes boards as soon as they are generated. */
+} search_policy_t;
+
+/* Queue every unseen successor of the current board. Returns nonzero if out of room. */
+typedef int (*expand_fn)(game_t *game);
+
+/* The successor generator for a game and policy (expand.c): the state
+ *  graph's if the game has one, else one built for that exact geometry if
+ *  there is one, otherwise the generic one. */
+expand_fn
+expand__select(game_t *game,
+               search_policy_t policy);
+
+/* Split the knights into pattern-database groups of 'knights' (0 for none).
+ *  Returns nonzero, changing nothing, if a group's table would be too large. */
+int
+pattern__configure(game_t *game,
+                   unsigned int knights);
+
+/* Build the pattern databases for the game's goal, unless they are already.
+ *  Returns nonzero if out of memory. */
+int
+pattern__build(game_t *game);
+
+void
+pattern__release(game_t *game);
+
+/* Bidirectional search (bidi.c), blind or with front-to-end A* heuristics. */
+solver_status_t
+bidi__solve(game_t *game,
+            int use_heuristic);
+
+/* Parallel A* (hda.c). Leaves the goal board as the current board, like the other searches. */
+solver_status_t
+hda__solve(game_t *game);
 
-    memcpy(game->current_board_state,
-           &game->initial_board_state,
-           sizeof(board_t));
+void
+hda__release(game_t *game);
+
+/* Anytime repairing A* (ara.c). Sets the result's bound, and reports each route found on the way. */
+solver_status_t
+ara__solve(game_t *game,
+           solver_result_t *result);
+
+/* Memory-bounded A* (sma.c), in at most the game's node budget. */
+solver_status_t
+sma__solve(game_t *game);
 
-    game->expansions = 0;
+/* Copy the route that ends at the current board into the solver's move buffer (solver.c). */
+solver_status_t
+record_solution(game_t *game,
+                solver_result_t *result);
 
-    queue__destroy(&game->priority_queue);
-    list__destroy(&game->solution_path, 0);
-    list__destroy(&game->visited_boards, 1);
 
-    game->priority_queue = queue__create(1 << 22);
-    game->solution_path = list__create();
-    game->visited_boards = list__create();
+/*
+ * Rank of the board after one knight moves, without re-ranking. Only the
+ * moving knight's digit and the digits of later knights whose slots lie
+ * between the two endpoints change, so this is a single pass over the
+ * other knights with no table walks.
+ */
+static inline
+unsigned long long
+rank_after_move(const layout_t *layout,
+                board_t *board,
+                int piece,
+                int from,
+                int to)
+{
+    int a = layout->rank_slot[from], b = layout->rank_slot[to];
+    long long delta = (b - a) * (long long)layout->rank_weight[piece];
+
+    for (int q = 0; q < (int)layout->pieces; ++q) {
+        int slot = layout->rank_slot[board->square[q]];
+
+        if (q < piece)
+            delta -= ((slot < b) - (slot < a)) * (long long)layout->rank_weight[piece];
+        else if (q > piece)
+            delta += ((a < slot) - (b < slot)) * (long long)layout->rank_weight[q];
+    }
+
+    return board->rank + delta;
+}
+
+
+/* Find which knight stands on an occupied square. Unused knights hold NO_SQUARE, so never match. */
+static inline
+int
+piece_at(board_t *board,
+         int square)
+{
+    int p = 0;
+    while (board->square[p] != square) ++p;
+    return p;
+}
+
+
+/* Allocate the board reached by moving one knight, linked back to its parent.
+ *  Returns NULL if the node arena cannot grow. */
+static inline
+board_t *
+spawn_successor_in(const layout_t *layout,
+                   arena_t *nodes,
+                   board_t *current_state,
+                   int piece,
+                   int from,
+                   int to)
+{
+    unsigned int new_index;
+    board_t *new_state = arena__alloc(nodes, &new_index);
+    if (NULL == new_state) return NULL;
+
+    *new_state = *current_state;
+
+    /* Move the piece to the new space. The old space becomes EMPTY. */
+    new_state->square[piece] = to;
+    new_state->occupied ^= (1U << from) | (1U << to);
+    new_state->rank = rank_after_move(layout, current_state, piece, from, to);
+    new_state->hash ^= layout->zobrist_key[from][piece] ^ layout->zobrist_key[to][piece];
+
+    /* Track the parent state we expanded from. */
+    new_state->node_index = new_index;
+    new_state->parent_index = current_state->node_index;
+    new_state->moves_from_start = current_state->moves_from_start + 1;
+
+    return new_state;
+}
+
+
+/* Index of a board's pattern for one pattern-database group. */
+static inline
+unsigned int
+pattern_index(const patterns_t *patterns,
+              board_t *board,
+              unsigned int group)
+{
+    unsigned int index = 0;
+
+    for (unsigned int j = 0; j < patterns->member_count[group]; ++j) {
+        unsigned int piece = patterns->member[group][j];
+        index += patterns->digit[piece][board->square[piece]];
+    }
+
+    return index;
+}
+
+
+/* h(x) of the board after one knight moves: only that knight's term changes,
+ *  or with pattern databases, only its group's entry. */
+static inline
+unsigned int
+heuristic_after_move(game_t *game,
+                     board_t *board,
+                     int piece,
+                     int from,
+                     int to)
+{
+    const patterns_t *patterns = &game->patterns;
+
+    if (0 == patterns->group_count)
+        return board->h_x - game->heuristic_term[piece][from] + game->heuristic_term[piece][to];
+
+    unsigned int group = patterns->group_of[piece];
+    unsigned int index = pattern_index(patterns, board, group);
+    unsigned int moved = index - patterns->digit[piece][from] + patterns->digit[piece][to];
+
+    return board->h_x - patterns->distance[group][index] + patterns->distance[group][moved];
+}
+
+
+/* As spawn_successor_in(), in the game's own node arena, keeping h(x) up to date.
+ *  (Boards from spawn_successor_in() carry their parent's h(x).) */
+static inline
+board_t *
+spawn_successor(game_t *game,
+                board_t *current_state,
+                int piece,
+                int from,
+                int to)
+{
+    board_t *new_state = spawn_successor_in(&game->layout, game->nodes, current_state, piece, from, to);
+    if (NULL == new_state) return NULL;
+
+    new_state->h_x = heuristic_after_move(game, current_state, piece, from, to);
+    return new_state;
 }
 
 
@@ -139,113 +515,141 @@ static inline
 int
 check_game(game_t *game)
 {
-    return memcmp(game->current_board_state->s,
-                  game->goal_board_state.s,
-                  BOARD_SIZE * sizeof(board_space_state_t));
+    return game->current_board_state->placement != game->goal_board_state.placement;
 }
 
 
-/* Print the current board state. */
-static
-void
-print_board(board_t *board)
-{
-    /* '9' is used here because it is the total size of all board states. */
-    for (int i = 0; i < BOARD_SIZE; ++i) {
-        switch (board->s[i]) {
-            case EMPTY: debug("."); break;
-            case BLACK_1: debug("B"); break;
-            case BLACK_2: debug("b"); break;
-            case WHITE_1: debug("W"); break;
-            case WHITE_2: debug("w"); break;
-        }
-        /* Print a line break if the indexer is a multiple of 3 and above 0. */
-        if (i > 0 && !((i+1) % 3)) debug("\n");
-    }
+/*
+ * Keys for duplicate detection. Boards mapped onto each other by a
+ * symmetry that fixes the goal are equally far from it, and the heuristic
+ * can't tell them apart either, so a search need only visit one of each
+ * class. board_class() gives the class representative, using 'scratch'
+ * unless the board is its own. The boards in the search are never
+ * transformed, so the parent links still form a playable route.
+ */
+static inline
+board_t *
+board_class(game_t *game,
+            board_t *board,
+            board_t *scratch)
+{
+    if (1 == game->goal_symmetries) return board;
+
+    canonical_board(&game->layout, scratch, board, game->goal_symmetries);
+    return scratch;
 }
 
 
-/* Print the series of moves discovered by the search. */
-static
+/*
+ * A board's images under the symmetries fixing the goal, taken once per
+ * expansion. A move maps onto a move in every image, so each successor's
+ * class rank then costs one rank_after_move() per image instead of a
+ * full transform and re-rank (see class_rank_after_move()).
+ */
+typedef struct
+{
+    unsigned int  count;
+    unsigned char symmetry[SYMMETRY_COUNT];
+    board_t       image[SYMMETRY_COUNT];
+} board_images_t;
+
+static inline
 void
-print_final_game_solution(game_t *game)
+board_images(game_t *game,
+             board_images_t *images,
+             board_t *board)
 {
-    debug("\n\n\n========================================\nFinal game route (%u steps):\n",
-           game->current_board_state->moves_from_start);
+    unsigned int symmetries = game->goal_symmetries & game->layout.symmetries;
+
+    images->count = 0;
+    for (unsigned int s = 1; s < SYMMETRY_COUNT; ++s) {
+        if (0 == (symmetries & (1U << s))) continue;
 
-    /* Create a linked list from the series of board states going backward. */
-    board_t *prev_board = game->current_board_state;
-    while (NULL != prev_board) {
-        list__insert(game->solution_path, prev_board);
-        prev_board = prev_board->parent_state;
+        transform_board(&game->layout, &images->image[images->count], board, s);
+        images->symmetry[images->count++] = s;
     }
+}
 
-    /* Reverse the list so it becomes a forward path. */
-    list__reverse(game->solution_path);
 
-    /* Traverse the list and print each board state. */
-    list_node_t *node = game->solution_path->head;
-    while (NULL != node) {
-        print_board((board_t *)node->node);
-        debug("\n");
-        node = node->next;
+/* The class rank (as board_class() would give) of the board reached by a
+ * move from the board whose images these are, and whose new rank is 'rank'. */
+static inline
+unsigned long long
+class_rank_after_move(const layout_t *layout,
+                      board_images_t *images,
+                      unsigned long long rank,
+                      int piece,
+                      int from,
+                      int to)
+{
+    for (unsigned int k = 0; k < images->count; ++k) {
+        unsigned int s = images->symmetry[k];
+        unsigned long long image_rank = rank_after_move(layout, &images->image[k],
+                                                        layout->symmetry_piece[s][piece],
+                                                        layout->symmetry_square[s][from],
+                                                        layout->symmetry_square[s][to]);
+        if (image_rank < rank) rank = image_rank;
     }
+
+    return rank;
 }
 
 
-/* Pseudo-hashing function identifying unique board states. */
-static
-unsigned int
+/* Code identifying unique board states: the board's dense rank. */
+static inline
+unsigned long long
 get_state_code(board_t *board)
 {
-    unsigned int state_code = 0;
-
-    /* The '5.0' here comes from the fact that each space can be in
-     * one of 5 different states based on EMPTY or the piece. */
-    for (int k = 0; k < BOARD_SIZE; k++)
-        state_code += (pow(5.0, (1.0 * k)) * board->s[k]);
-
-    return state_code;
+    return board->rank;
 }
 
 
-/* Get the estimated value of h(x) for a legal board state. */
-static
+/* Estimate the number of moves between two legal board states. */
+static inline
 unsigned int
-get_heuristic(board_t *next_state,
-              game_t  *game)
+get_heuristic_to(const layout_t *layout,
+                 board_t *next_state,
+                 board_t *target)
 {
     /*
-     * ALL Four Knights puzzles create a node graph with a cyclical
-     * set of legal state transitions. This is a cyclic number line.
-     * At any given time, the heuristic H(x) measurement is defined
-     * by how far away on this CYCLE GRAPH the current point is from
-     * its desired destination in the cycle.
+     * Every move carries one knight one step along the move graph, so the
+     * moves still needed are at least the sum of each knight's own
+     * shortest distance to where it should end up, other knights aside.
+     * On 3x3 the move graph is a single eight-square cycle and this is
+     * the distance around that cycle.
      *
      * See: https://mindyourdecisions.com/blog/wp-content/uploads/2014/03/four-knights-puzzle-solution-final-graph.png
      */
-    int cycle[8] = { 6, 1, 8, 3, 2, 7, 0, 5 };
     unsigned int h_x = 0;
 
-    for (int i = 0; i < BOARD_SIZE; ++i) {
-        /* Skip empty goal places, where there is no measurement to make. */
-        if (EMPTY == game->goal_board_state.s[i]) continue;
+    for (unsigned int p = 0; p < layout->pieces; ++p)
+        h_x += layout->square_distance[next_state->square[p]][target->square[p]];
+
+    return h_x;
+}
+
 
-        for (int j = 0; j < BOARD_SIZE; ++j) {
-            /* If the type of piece doesn't match here for 'j', continue till it does. */
-            if (next_state->s[j] != game->goal_board_state.s[i]) continue;
+/* Get the estimated value of h(x) for a legal board state, from scratch.
+ *  Searches only do this for the start board; every other board's h(x)
+ *  is its parent's, updated by heuristic_after_move(). */
+static inline
+unsigned int
+get_heuristic(board_t *next_state,
+              game_t  *game)
+{
+    const patterns_t *patterns = &game->patterns;
+    unsigned int h_x = 0;
 
-            /* Find the index in the cycle for each value. */
-            int i_curr = 0, i_goal = 0;
-            while (cycle[i_goal] != i) ++i_goal;
-            while (cycle[i_curr] != j) ++i_curr;
+    if (0 != patterns->group_count) {
+        for (unsigned int g = 0; g < patterns->group_count; ++g)
+            h_x += patterns->distance[g][pattern_index(patterns, next_state, g)];
 
-            /* Add the absolute distance in the cycle from the current location
-             * to the desired location in the goal state. */
-            h_x += MIN(abs(i_goal - i_curr), 8 - abs(i_goal - i_curr));
-        }
+        return h_x;
     }
 
+    for (unsigned int p = 0; p < game->layout.pieces; ++p)
+        h_x += game->heuristic_term[p][next_state->square[p]];
+
     return h_x;
 }
 
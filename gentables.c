@@ -0,0 +1,110 @@
+/*
+ * gentables.c
+ *
+ *  Build-time generator for geometries.h: the move, ranking and hashing
+ *  tables of each specialized board geometry, as static data,
+ *  followed by an instantiation of expand.h for it.
+ *
+ *  Usage: gentables ROWSxCOLUMNSkKNIGHTS...   (e.g. 'gentables 3x3k2 3x4k3')
+ *
+ *  The tables come from build_layout(), so a specialized engine and the
+ *  generic one always agree on every rank and hash.
+ */
+
+#include "game.h"
+
+#include <stdio.h>
+
+
+static
+void
+print_geometry(const layout_t *layout,
+               const char *tag)
+{
+    printf("\n\n/* %ux%u, %u knights a side. */\n",
+           layout->rows, layout->columns, layout->knights_per_side);
+
+    printf("static const unsigned int dest_mask_%s[%u] = {", tag, layout->squares);
+    for (unsigned int i = 0; i < layout->squares; ++i)
+        printf("%s%s0x%08x", i ? "," : "", i % 6 ? " " : "\n    ", layout->dest_mask[i]);
+    printf("\n};\n");
+
+    printf("static const signed char rank_slot_%s[%u] = {", tag, layout->squares);
+    for (unsigned int i = 0; i < layout->squares; ++i)
+        printf("%s%s%d", i ? "," : "", i % 12 ? " " : "\n    ", layout->rank_slot[i]);
+    printf("\n};\n");
+
+    printf("static const unsigned long long rank_weight_%s[%u] = {", tag, layout->pieces);
+    for (unsigned int p = 0; p < layout->pieces; ++p)
+        printf("%s%s%lluULL", p ? "," : "", p % 4 ? " " : "\n    ", layout->rank_weight[p]);
+    printf("\n};\n");
+
+    printf("static const unsigned long long zobrist_key_%s[%u][%u] = {\n",
+           tag, layout->squares, layout->pieces);
+    for (unsigned int i = 0; i < layout->squares; ++i) {
+        printf("    {");
+        for (unsigned int p = 0; p < layout->pieces; ++p)
+            printf("%s0x%016llxULL", p ? ", " : " ", layout->zobrist_key[i][p]);
+        printf(" },\n");
+    }
+    printf("};\n\n");
+
+    printf("#define EXPAND(name)              expand__%s_##name\n", tag);
+    printf("#define E_PIECES                  %uU\n", layout->pieces);
+    printf("#define E_DEST_MASK(square)       dest_mask_%s[square]\n", tag);
+    printf("#define E_RANK_SLOT(square)       rank_slot_%s[square]\n", tag);
+    printf("#define E_RANK_WEIGHT(piece)      rank_weight_%s[piece]\n", tag);
+    printf("#define E_ZOBRIST(square, piece)  zobrist_key_%s[square][piece]\n", tag);
+    printf("#include \"expand.h\"\n");
+    printf("#undef EXPAND\n"
+           "#undef E_PIECES\n"
+           "#undef E_DEST_MASK\n"
+           "#undef E_RANK_SLOT\n"
+           "#undef E_RANK_WEIGHT\n"
+           "#undef E_ZOBRIST\n");
+}
+
+
+int
+main(int argc,
+     char **argv)
+{
+    static layout_t layouts[16];
+    unsigned int count = argc - 1;
+
+    if (0 == count || count > sizeof(layouts) / sizeof(layouts[0])) {
+        fprintf(stderr, "Usage: %s ROWSxCOLUMNSkKNIGHTS...\n", argv[0]);
+        return 1;
+    }
+
+    for (unsigned int g = 0; g < count; ++g) {
+        unsigned int rows, columns, knights;
+        char end;
+
+        if (3 != sscanf(argv[g + 1], "%ux%uk%u%c", &rows, &columns, &knights, &end)
+                || 0 != build_layout(&layouts[g], rows, columns, knights)) {
+            fprintf(stderr, "%s: '%s' is not a board geometry this solver supports.\n",
+                    argv[0], argv[g + 1]);
+            return 1;
+        }
+    }
+
+    printf("/*\n"
+           " * geometries.h\n"
+           " *\n"
+           " *  Generated by gentables for the GEOMETRIES listed in the Makefile.\n"
+           " *  Do not edit; include it from expand.c only.\n"
+           " */");
+
+    for (unsigned int g = 0; g < count; ++g)
+        print_geometry(&layouts[g], argv[g + 1]);
+
+    /* The list the dispatcher in expand.c is built from. */
+    printf("\n\n#define SPECIALIZED_GEOMETRIES(X) \\\n");
+    for (unsigned int g = 0; g < count; ++g)
+        printf("    X(%u, %u, %u, %s)%s\n",
+               layouts[g].rows, layouts[g].columns, layouts[g].knights_per_side,
+               argv[g + 1], g + 1 < count ? " \\" : "");
+
+    return 0;
+}
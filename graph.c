@@ -0,0 +1,104 @@
+/*
+ * graph.c
+ *
+ *  The precomputed state graph: every position of a board, ranked, with
+ *  the moves out of it stored in compressed sparse row form.
+ *
+ *  Building it costs one unranking and one move generation per state,
+ *  after which a search finds each board's successors (and their ranks)
+ *  by scanning a contiguous run of two arrays. It pays off when many
+ *  puzzles are solved on the same board.
+ */
+
+#include "game.h"
+
+#include <stdlib.h>
+
+
+/* Make room for at least one more edge. Returns nonzero if out of memory. */
+static
+int
+reserve_edge(graph_t *graph,
+             unsigned int *capacity)
+{
+    if (graph->edge_count < *capacity) return 0;
+
+    unsigned int grown = *capacity ? 2 * *capacity : 1024;
+    unsigned int *targets = realloc(graph->targets, grown * sizeof(unsigned int));
+    if (NULL == targets) return -1;
+    graph->targets = targets;
+
+    unsigned short *moves = realloc(graph->moves, grown * sizeof(unsigned short));
+    if (NULL == moves) return -1;
+    graph->moves = moves;
+
+    *capacity = grown;
+    return 0;
+}
+
+
+solver_graph_t *
+solver__create_graph(const solver_board_t *board)
+{
+    layout_t *layout = malloc(sizeof(layout_t));
+    graph_t *graph = calloc(1, sizeof(graph_t));
+    if (NULL == layout || NULL == graph) goto failed;
+
+    if (0 != build_layout(layout, board->rows, board->columns, board->knights_per_side)
+            || layout->state_count > DENSE_STATE_LIMIT)
+        goto failed;
+
+    graph->rows = layout->rows;
+    graph->columns = layout->columns;
+    graph->knights_per_side = layout->knights_per_side;
+    graph->state_count = layout->state_count;
+    graph->offsets = malloc((layout->state_count + 1) * sizeof(unsigned int));
+    if (NULL == graph->offsets) goto failed;
+
+    unsigned int capacity = 0;
+    for (unsigned int rank = 0; rank < layout->state_count; ++rank) {
+        board_t board;
+        unrank_board(layout, &board, rank);
+        graph->offsets[rank] = graph->edge_count;
+
+        /* The same walk as the searches: occupied squares, then targets, in board order. */
+        unsigned int empty = ~board.occupied;
+        for (unsigned int from = board.occupied; from; from &= from - 1) {
+            int i = __builtin_ctz(from);
+            int piece = piece_at(&board, i);
+
+            for (unsigned int to = empty & layout->dest_mask[i]; to; to &= to - 1) {
+                int dest = __builtin_ctz(to);
+                if (0 != reserve_edge(graph, &capacity)) goto failed;
+
+                graph->targets[graph->edge_count] = (unsigned int)rank_after_move(layout, &board, piece, i, dest);
+                graph->moves[graph->edge_count] = GRAPH_MOVE(piece, i, dest);
+                ++graph->edge_count;
+            }
+        }
+    }
+    graph->offsets[layout->state_count] = graph->edge_count;
+
+    debug("\n-- State graph built: %llu states, %u moves.\n",
+          graph->state_count, graph->edge_count);
+    free(layout);
+    return graph;
+
+failed:
+    free(layout);
+    solver__destroy_graph(&graph);
+    return NULL;
+}
+
+
+void
+solver__destroy_graph(solver_graph_t **graph)
+{
+    if (NULL == graph || NULL == *graph) return;
+
+    free((*graph)->offsets);
+    free((*graph)->targets);
+    free((*graph)->moves);
+    free(*graph);
+    *graph = NULL;
+}
@@ -0,0 +1,212 @@
+/*
+ * hashmap.c
+ *
+ *  Implementation of the open-addressing hash table behind both the
+ *  hash map and the closed list's hash set, which is a map without its
+ *  values array.
+ */
+
+#include "hashmap.h"
+#include "stats.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+
+#define HASHMAP_MIN_CAPACITY  64
+
+
+static inline
+unsigned int
+slot_for(hashmap_t *map,
+         hashmap_key_t key)
+{
+    /* Fibonacci hashing spreads the (very regular) state codes over the table. */
+    return (unsigned int)((key * 0x9E3779B97F4A7C15ULL) >> map->shift);
+}
+
+
+/* The slot holding a nonzero key, or the free slot its probe run ends at. */
+static inline
+unsigned int
+probe(hashmap_t *map,
+      hashmap_key_t key)
+{
+    unsigned int slot = slot_for(map, key);
+    while (0 != map->keys[slot] && key != map->keys[slot])
+        slot = (slot + 1) & (map->capacity - 1);
+
+    return slot;
+}
+
+
+/* Give the table empty slots, at least 'capacity' of them. Returns nonzero,
+ *  leaving the table as it was, if out of memory. */
+static
+int
+allocate_slots(hashmap_t *map,
+               unsigned int capacity,
+               int with_values)
+{
+    unsigned int bits = 0;
+    while ((1U << bits) < capacity) ++bits;
+
+    hashmap_key_t *keys = (hashmap_key_t *)calloc(1U << bits, sizeof(hashmap_key_t));
+    unsigned int *values = NULL;
+    if (with_values)
+        values = (unsigned int *)malloc((1U << bits) * sizeof(unsigned int));
+
+    if (NULL == keys || (with_values && NULL == values)) {
+        free(keys);
+        free(values);
+        return -1;
+    }
+
+    map->keys = keys;
+    map->values = values;
+    map->capacity = 1U << bits;
+    map->shift = 64 - bits;
+
+    STAT_ADD(SOLVER_STAT_BYTES, map->capacity * (sizeof(hashmap_key_t) + (values ? sizeof(unsigned int) : 0)));
+    return 0;
+}
+
+
+static
+int
+grow(hashmap_t *map)
+{
+    hashmap_key_t *old_keys = map->keys;
+    unsigned int *old_values = map->values;
+    unsigned int old_capacity = map->capacity;
+
+    if (0 != allocate_slots(map, old_capacity << 1, NULL != old_values)) return -1;
+
+    /* Re-seat every live entry into the larger table. */
+    for (unsigned int i = 0; i < old_capacity; ++i) {
+        if (0 == old_keys[i]) continue;
+
+        unsigned int slot = probe(map, old_keys[i]);
+        map->keys[slot] = old_keys[i];
+        if (NULL != old_values) map->values[slot] = old_values[i];
+    }
+
+    free(old_keys);
+    free(old_values);
+    return 0;
+}
+
+
+hashmap_t *
+hashmap__create_table(unsigned int capacity,
+                      int with_values)
+{
+    hashmap_t *map = calloc(1, sizeof(hashmap_t));
+    if (NULL == map) return NULL;
+
+    if (0 != allocate_slots(map,
+                            capacity < HASHMAP_MIN_CAPACITY ? HASHMAP_MIN_CAPACITY : capacity,
+                            with_values)) {
+        free(map);
+        return NULL;
+    }
+
+    return map;
+}
+
+
+hashmap_t *
+hashmap__create(unsigned int capacity)
+{
+    return hashmap__create_table(capacity, 1);
+}
+
+
+void
+hashmap__destroy(hashmap_t **map)
+{
+    if (NULL == map || NULL == *map) return;
+
+    free((*map)->keys);
+    free((*map)->values);
+    free(*map);
+    *map = NULL;
+}
+
+
+void
+hashmap__clear(hashmap_t *map)
+{
+    /* Only the keys mark which slots are live. Keep the grown table around
+     * so repeated searches don't re-grow it. */
+    memset(map->keys, 0, map->capacity * sizeof(hashmap_key_t));
+    map->count = 0;
+    map->has_zero = 0;
+}
+
+
+int
+hashmap__contains(hashmap_t *map,
+                  hashmap_key_t key)
+{
+    if (0 == key) return map->has_zero;
+    return 0 != map->keys[probe(map, key)];
+}
+
+
+int
+hashmap__claim(hashmap_t *map,
+               hashmap_key_t key,
+               unsigned int **value)
+{
+    if (0 == key) {
+        if (NULL != value) *value = &map->zero_value;
+        if (map->has_zero) return 0;
+
+        map->has_zero = 1;
+        ++map->count;
+        return 1;
+    }
+
+    unsigned int slot = probe(map, key);
+    if (0 == map->keys[slot]) {
+        /* Keep the load factor at or below one half so probe runs stay short. */
+        if (2 * (map->count + 1) > map->capacity) {
+            if (0 != grow(map)) return -1;
+            slot = probe(map, key);
+        }
+
+        map->keys[slot] = key;
+        ++map->count;
+        if (NULL != value) *value = &map->values[slot];
+        return 1;
+    }
+
+    if (NULL != value) *value = &map->values[slot];
+    return 0;
+}
+
+
+unsigned int
+hashmap__get(hashmap_t *map,
+             hashmap_key_t key,
+             unsigned int missing)
+{
+    if (0 == key) return map->has_zero ? map->zero_value : missing;
+
+    unsigned int slot = probe(map, key);
+    return (0 != map->keys[slot]) ? map->values[slot] : missing;
+}
+
+
+int
+hashmap__put(hashmap_t *map,
+             hashmap_key_t key,
+             unsigned int value)
+{
+    unsigned int *stored;
+    if (hashmap__claim(map, key, &stored) < 0) return -1;
+
+    *stored = value;
+    return 0;
+}
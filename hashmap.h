@@ -0,0 +1,84 @@
+/*
+ * hashmap.h
+ *
+ *  Definitions for an open-addressing hash map from board ranks to
+ *  small values, for searches whose state space is too large for arrays
+ *  indexed by rank. Ranks are exact, so a hit is always the same board.
+ *  The closed list's hash set (hashset.h) is the same table without
+ *  values.
+ */
+
+#ifndef FOURKNIGHTS_HASHMAP_H
+#define FOURKNIGHTS_HASHMAP_H
+
+
+typedef unsigned long long hashmap_key_t;
+
+typedef struct
+{
+    hashmap_key_t *keys;        /* Linear-probed slots; 0 marks a free slot. */
+    unsigned int  *values;      /* NULL for a set. */
+    unsigned int   capacity;    /* Always a power of two. */
+    unsigned int   count;       /* Number of stored keys, including zero. */
+    unsigned int   shift;       /* 64 - log2(capacity), for Fibonacci hashing. */
+    int            has_zero;    /* The zero key is tracked out-of-band. */
+    unsigned int   zero_value;
+} hashmap_t;
+
+
+hashmap_t *
+hashmap__create(
+    unsigned int capacity
+);
+
+/* A map, or with 'with_values' zero a set of keys only. */
+hashmap_t *
+hashmap__create_table(
+    unsigned int capacity,
+    int with_values
+);
+
+void
+hashmap__destroy(
+    hashmap_t **map
+);
+
+void
+hashmap__clear(
+    hashmap_t *map
+);
+
+int
+hashmap__contains(
+    hashmap_t *map,
+    hashmap_key_t key
+);
+
+/* Add 'key' if it is missing. Returns 1 if it was added, 0 if it was there,
+ *  or -1 if out of memory. For a map, 'value' (if not NULL) is pointed at
+ *  where the key's value is kept; a new key's is unset. */
+int
+hashmap__claim(
+    hashmap_t *map,
+    hashmap_key_t key,
+    unsigned int **value
+);
+
+/* The value stored for 'key', or 'missing' if there is none. */
+unsigned int
+hashmap__get(
+    hashmap_t *map,
+    hashmap_key_t key,
+    unsigned int missing
+);
+
+/* Returns nonzero if out of memory. */
+int
+hashmap__put(
+    hashmap_t *map,
+    hashmap_key_t key,
+    unsigned int value
+);
+
+
+#endif   /* FOURKNIGHTS_HASHMAP_H */
@@ -0,0 +1,57 @@
+/*
+ * hashset.h
+ *
+ *  Definitions for an open-addressing hash set of state codes: the hash
+ *  map's table (hashmap.c) with keys only.
+ */
+
+#ifndef FOURKNIGHTS_HASHSET_H
+#define FOURKNIGHTS_HASHSET_H
+
+#include "hashmap.h"
+
+
+typedef hashmap_key_t hashset_key_t;
+typedef hashmap_t     hashset_t;
+
+
+static inline
+hashset_t *
+hashset__create(unsigned int capacity)
+{
+    return hashmap__create_table(capacity, 0);
+}
+
+static inline
+void
+hashset__destroy(hashset_t **set)
+{
+    hashmap__destroy(set);
+}
+
+static inline
+void
+hashset__clear(hashset_t *set)
+{
+    hashmap__clear(set);
+}
+
+static inline
+int
+hashset__contains(hashset_t *set,
+                  hashset_key_t key)
+{
+    return hashmap__contains(set, key);
+}
+
+/* Returns 1 if the key was added, 0 if it was already there, or -1 if out of memory. */
+static inline
+int
+hashset__insert(hashset_t *set,
+                hashset_key_t key)
+{
+    return hashmap__claim(set, key, NULL);
+}
+
+
+#endif   /* FOURKNIGHTS_HASHSET_H */
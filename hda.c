@@ -0,0 +1,604 @@
+/*
+ * hda.c
+ *
+ *  Hash-distributed A* (HDA*): one search spread over several threads.
+ *
+ *  Every board has an owner thread chosen from its Zobrist hash. Only the
+ *  owner keeps that board's best g(x), open entry and arena node, so no
+ *  search structure is ever shared. A thread expanding a board sends each
+ *  successor to its owner in batches over that owner's MPSC inbox, and
+ *  keeps the ones it owns itself.
+ *
+ *  Threads pop from their own open lists independently, so boards can be
+ *  expanded before a cheaper path to them arrives. Such boards are simply
+ *  reopened. The goal found first is only an incumbent: the search ends
+ *  once no thread has an open board below its cost and nothing is still
+ *  in flight, at which point the incumbent is optimal.
+ */
+
+#include "game.h"
+#include "hashmap.h"
+#include "mpsc.h"
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+/* Successors sent in one message, and expansions between forced flushes. */
+#define HDA_BATCH_SIZE       64
+#define HDA_FLUSH_INTERVAL   8
+
+#define HDA_NO_INCUMBENT     (~0U)
+
+
+/* A message: successors for one owner, each with its parent as a node reference. */
+typedef struct
+{
+    mpsc_node_t  link;
+    unsigned int count;
+    board_t      boards[HDA_BATCH_SIZE];
+} hda_batch_t;
+
+typedef struct _hda hda_t;
+
+typedef struct
+{
+    mpsc_t        inbox;         /* First, so it keeps its cache-line alignment. */
+    hda_t        *hda;
+    unsigned int  id;
+    arena_t      *nodes;
+    queue_t      *open;
+    hashmap_t    *best_g;        /* Best g(x) seen for each board this thread owns, by rank. */
+    hda_batch_t **outbox;        /* Batches being filled, by destination thread. */
+    unsigned int  expansions;
+#ifdef FN_STATS
+    stats_block_t stats;         /* This thread's counters, merged into the solver's at the end. */
+#endif
+    pthread_t     thread;
+} hda_worker_t;
+
+struct _hda
+{
+    game_t         *game;
+    hda_worker_t   *workers;
+    unsigned int    worker_count;
+
+    pthread_mutex_t incumbent_lock;
+    atomic_uint     incumbent_cost;      /* Cost of the best goal found, or HDA_NO_INCUMBENT. */
+    unsigned int    incumbent_node;      /* Its node reference (under the lock). */
+
+    /*
+     * Termination: 'in_flight' counts boards sent but not yet received,
+     * and 'wakeups' ticks whenever an idle thread takes new work. If every
+     * thread is idle, nothing is in flight and no thread woke up while
+     * that was being checked, the search is over.
+     */
+    atomic_uint     idle;
+    atomic_ulong    wakeups;
+    atomic_long     in_flight;
+    atomic_int      done;
+    atomic_int      failed;
+};
+
+
+/*
+ * Nodes live in the arena of the thread that owns them, so a parent link
+ * names both: the arena index times the thread count, plus the thread.
+ * accept_board() refuses any node whose reference would not fit.
+ */
+static inline
+unsigned int
+node_reference(hda_t *hda,
+               unsigned int thread,
+               unsigned int index)
+{
+    return index * hda->worker_count + thread;
+}
+
+
+static inline
+board_t *
+resolve_node(hda_t *hda,
+             unsigned int reference)
+{
+    hda_worker_t *owner = &hda->workers[reference % hda->worker_count];
+    return arena__at(owner->nodes, reference / hda->worker_count);
+}
+
+
+/* The thread responsible for a board, from the high bits of its hash. */
+static inline
+unsigned int
+owner_of(hda_t *hda,
+         board_t *board)
+{
+    return (unsigned int)(((board->hash >> 32) * hda->worker_count) >> 32);
+}
+
+
+static
+void
+fail(hda_t *hda)
+{
+    atomic_store(&hda->failed, 1);
+    atomic_store(&hda->done, 1);
+}
+
+
+/* Take in a board this thread owns, whether generated here or received. */
+static
+int
+accept_board(hda_worker_t *worker,
+             board_t *board)
+{
+    hda_t *hda = worker->hda;
+    unsigned int g_x = board->moves_from_start;
+
+    if (g_x >= hashmap__get(worker->best_g, get_state_code(board), ~0U)) {
+        STAT_ADD(SOLVER_STAT_DUPLICATES, 1);
+        return 0;
+    }
+    if (0 != hashmap__put(worker->best_g, get_state_code(board), g_x)) return -1;
+
+    unsigned int h_x = board->h_x;
+    unsigned int f_x = g_x + h_x;
+    if (f_x >= atomic_load_explicit(&hda->incumbent_cost, memory_order_relaxed)) return 0;
+
+    unsigned int index;
+    board_t *node = arena__alloc(worker->nodes, &index);
+    if (NULL == node) return -1;
+
+    /* The node reference must fit in 32 bits and stay clear of ARENA_NO_NODE. */
+    if (index > (ARENA_NO_NODE - 1 - worker->id) / hda->worker_count) return -1;
+
+    *node = *board;
+    node->node_index = node_reference(hda, worker->id, index);
+
+    /* Boards already closed are simply queued again (reopened). */
+    unsigned int handle = (unsigned int)node->rank;
+    STAT_ADD(SOLVER_STAT_PUSHES, 1);
+    if (NULL != queue__find(worker->open, handle))
+        return queue__decrease_key(worker->open, handle, node, f_x, g_x, h_x);
+
+    int error = queue__insert_indexed(worker->open, handle, node, f_x, g_x, h_x);
+    STAT_PEAK(SOLVER_STAT_OPEN_PEAK, worker->open->current_size);
+    return error;
+}
+
+
+/* Hand every partly-filled batch to its owner. */
+static
+void
+flush_outbox(hda_worker_t *worker)
+{
+    hda_t *hda = worker->hda;
+
+    for (unsigned int w = 0; w < hda->worker_count; ++w) {
+        hda_batch_t *batch = worker->outbox[w];
+        if (NULL == batch || 0 == batch->count) continue;
+
+        /* Counted before it is visible, so it can never look delivered early. */
+        atomic_fetch_add(&hda->in_flight, batch->count);
+        mpsc__push(&hda->workers[w].inbox, &batch->link);
+        worker->outbox[w] = NULL;
+    }
+}
+
+
+static
+int
+send_board(hda_worker_t *worker,
+           unsigned int owner,
+           board_t *board)
+{
+    hda_batch_t *batch = worker->outbox[owner];
+
+    if (NULL == batch) {
+        batch = malloc(sizeof(hda_batch_t));
+        if (NULL == batch) return -1;
+
+        batch->count = 0;
+        worker->outbox[owner] = batch;
+    }
+
+    batch->boards[batch->count++] = *board;
+    if (HDA_BATCH_SIZE == batch->count) {
+        atomic_fetch_add(&worker->hda->in_flight, batch->count);
+        mpsc__push(&worker->hda->workers[owner].inbox, &batch->link);
+        worker->outbox[owner] = NULL;
+    }
+
+    return 0;
+}
+
+
+/* Accept every batch waiting in the inbox. Returns how many arrived, or -1. */
+static
+int
+drain_inbox(hda_worker_t *worker,
+            int idle)
+{
+    hda_t *hda = worker->hda;
+    int received = 0;
+    mpsc_node_t *link;
+
+    while (NULL != (link = mpsc__pop(&worker->inbox))) {
+        hda_batch_t *batch = (hda_batch_t *)link;
+
+        /* Leave the idle count before the boards stop counting as in flight. */
+        if (idle && 0 == received) {
+            atomic_fetch_add(&hda->wakeups, 1);
+            atomic_fetch_sub(&hda->idle, 1);
+        }
+
+        for (unsigned int i = 0; i < batch->count; ++i)
+            if (0 != accept_board(worker, &batch->boards[i])) {
+                free(batch);
+                return -1;
+            }
+
+        atomic_fetch_sub(&hda->in_flight, batch->count);
+        received += batch->count;
+        free(batch);
+    }
+
+    return received;
+}
+
+
+/* Generate the successors of a board and route each one to its owner. */
+static
+int
+expand_board(hda_worker_t *worker,
+             board_t *current_state)
+{
+    hda_t *hda = worker->hda;
+    const layout_t *layout = &hda->game->layout;
+    unsigned int empty = ~current_state->occupied;
+    unsigned int incumbent = atomic_load_explicit(&hda->incumbent_cost, memory_order_relaxed);
+
+    for (unsigned int from = current_state->occupied; from; from &= from - 1) {
+        int i = __builtin_ctz(from);
+        int piece = piece_at(current_state, i);
+
+        for (unsigned int to = empty & layout->dest_mask[i]; to; to &= to - 1) {
+            int dest = __builtin_ctz(to);
+
+            board_t successor = *current_state;
+            successor.square[piece] = dest;
+            successor.occupied ^= (1U << i) | (1U << dest);
+            successor.rank = rank_after_move(layout, current_state, piece, i, dest);
+            successor.hash ^= layout->zobrist_key[i][piece] ^ layout->zobrist_key[dest][piece];
+            successor.h_x = heuristic_after_move(hda->game, current_state, piece, i, dest);
+            successor.parent_index = current_state->node_index;
+            successor.moves_from_start = current_state->moves_from_start + 1;
+            STAT_ADD(SOLVER_STAT_SUCCESSORS, 1);
+
+            /* Nothing at or above the incumbent's cost can improve on it. */
+            if (successor.moves_from_start + successor.h_x >= incumbent)
+                continue;
+
+            unsigned int owner = owner_of(hda, &successor);
+            int error = (owner == worker->id)
+                ? accept_board(worker, &successor)
+                : send_board(worker, owner, &successor);
+            if (0 != error) return -1;
+        }
+    }
+
+    return 0;
+}
+
+
+/* Check, from an idle thread, whether the whole search has finished. */
+static
+int
+search_finished(hda_t *hda)
+{
+    unsigned long before = atomic_load(&hda->wakeups);
+
+    if (atomic_load(&hda->idle) != hda->worker_count) return 0;
+    if (0 != atomic_load(&hda->in_flight)) return 0;
+
+    return before == atomic_load(&hda->wakeups);
+}
+
+
+static
+void *
+run_worker(void *argument)
+{
+    hda_worker_t *worker = argument;
+    hda_t *hda = worker->hda;
+    unsigned int since_flush = 0;
+
+#ifdef FN_STATS
+    stats_block_t *previous = stats__bind(&worker->stats);
+#endif
+
+    while (!atomic_load_explicit(&hda->done, memory_order_acquire)) {
+        if (drain_inbox(worker, 0) < 0) { fail(hda); break; }
+
+        queue_object_t queue_obj = queue__get_min(worker->open);
+        unsigned int incumbent = atomic_load(&hda->incumbent_cost);
+
+        /* Whatever is left here costs at least as much as the incumbent. */
+        if (NULL == queue_obj.item || queue_obj.F >= incumbent) {
+            flush_outbox(worker);
+            since_flush = 0;
+
+            atomic_fetch_add(&hda->idle, 1);
+            for (;;) {
+                int received = drain_inbox(worker, 1);
+                if (received < 0) { fail(hda); break; }
+                if (received > 0) break;
+
+                if (atomic_load(&hda->done)) break;
+                if (search_finished(hda)) {
+                    atomic_store_explicit(&hda->done, 1, memory_order_release);
+                    break;
+                }
+
+                sched_yield();
+            }
+
+            continue;
+        }
+
+        board_t *current_state = queue_obj.item;
+        STAT_ADD(SOLVER_STAT_POPS, 1);
+
+        /* Without a rank index the open list keeps superseded entries. */
+        if (queue_obj.G > hashmap__get(worker->best_g, get_state_code(current_state), ~0U)) continue;
+
+        /* A goal ends no search by itself; it only lowers the bound. */
+        if (current_state->placement == hda->game->goal_board_state.placement) {
+            pthread_mutex_lock(&hda->incumbent_lock);
+            if (queue_obj.G < atomic_load(&hda->incumbent_cost)) {
+                hda->incumbent_node = current_state->node_index;
+                atomic_store(&hda->incumbent_cost, queue_obj.G);
+            }
+            pthread_mutex_unlock(&hda->incumbent_lock);
+            continue;
+        }
+
+        ++worker->expansions;
+        if (0 != expand_board(worker, current_state)) { fail(hda); break; }
+
+        if (++since_flush == HDA_FLUSH_INTERVAL) {
+            flush_outbox(worker);
+            since_flush = 0;
+        }
+    }
+
+#ifdef FN_STATS
+    stats__bind(previous);
+#endif
+    return NULL;
+}
+
+
+/* Free a worker pool and everything its workers own. */
+static
+void
+release_pool(hda_t *hda)
+{
+    for (unsigned int w = 0; w < hda->worker_count; ++w) {
+        hda_worker_t *worker = &hda->workers[w];
+
+        /* Only a failed search can leave batches behind. */
+        mpsc_node_t *link;
+        while (NULL != (link = mpsc__pop(&worker->inbox))) free(link);
+
+        if (NULL != worker->outbox)
+            for (unsigned int d = 0; d < hda->worker_count; ++d)
+                free(worker->outbox[d]);
+
+        free(worker->outbox);
+        queue__destroy(&worker->open);
+        hashmap__destroy(&worker->best_g);
+        arena__destroy(&worker->nodes);
+    }
+
+    free(hda->workers);
+    pthread_mutex_destroy(&hda->incumbent_lock);
+    free(hda);
+}
+
+
+/* Build a pool of 'worker_count' workers for the game. Returns NULL if out of memory. */
+static
+hda_t *
+create_pool(game_t *game,
+            unsigned int worker_count)
+{
+    hda_t *hda = calloc(1, sizeof(hda_t));
+    if (NULL == hda) return NULL;
+
+    hda->game = game;
+    pthread_mutex_init(&hda->incumbent_lock, NULL);
+
+    hda->workers = aligned_alloc(64, worker_count * sizeof(hda_worker_t));
+    if (NULL == hda->workers) {
+        release_pool(hda);
+        return NULL;
+    }
+
+    memset(hda->workers, 0, worker_count * sizeof(hda_worker_t));
+    hda->worker_count = worker_count;
+
+    int ready = 1;
+    for (unsigned int w = 0; w < worker_count; ++w) {
+        hda_worker_t *worker = &hda->workers[w];
+
+        mpsc__init(&worker->inbox);
+        worker->hda = hda;
+        worker->id = w;
+        worker->nodes = arena__create(sizeof(board_t));
+        worker->open = queue__create(1 << 22, game->queue_kind);
+        worker->best_g = hashmap__create(1 << 10);
+        worker->outbox = calloc(worker_count, sizeof(hda_batch_t *));
+
+        if (NULL == worker->nodes || NULL == worker->open || NULL == worker->best_g || NULL == worker->outbox)
+            ready = 0;
+        else if (game->layout.state_count <= DENSE_STATE_LIMIT
+                     && 0 != queue__index(worker->open, game->layout.state_count))
+            ready = 0;
+    }
+
+    if (!ready) {
+        release_pool(hda);
+        return NULL;
+    }
+
+    return hda;
+}
+
+
+/* Empty every worker's structures for a new search, keeping their storage. */
+static
+void
+clear_pool(hda_t *hda)
+{
+    atomic_store(&hda->incumbent_cost, HDA_NO_INCUMBENT);
+    atomic_store(&hda->idle, 0);
+    atomic_store(&hda->wakeups, 0);
+    atomic_store(&hda->in_flight, 0);
+    atomic_store(&hda->done, 0);
+    atomic_store(&hda->failed, 0);
+
+    for (unsigned int w = 0; w < hda->worker_count; ++w) {
+        hda_worker_t *worker = &hda->workers[w];
+
+        /* Batches a failed search left behind are dropped; no thread is running. */
+        mpsc_node_t *link;
+        while (NULL != (link = mpsc__pop(&worker->inbox))) free(link);
+        mpsc__init(&worker->inbox);
+
+        for (unsigned int d = 0; d < hda->worker_count; ++d) {
+            free(worker->outbox[d]);
+            worker->outbox[d] = NULL;
+        }
+
+        arena__reset(worker->nodes);
+        queue__clear(worker->open);
+        hashmap__clear(worker->best_g);
+        worker->expansions = 0;
+#ifdef FN_STATS
+        memset(&worker->stats, 0, sizeof(stats_block_t));
+#endif
+    }
+}
+
+
+/* The game's worker pool, cleared for a new search. It is kept between
+ * solves and only rebuilt when the thread count changes. */
+static
+hda_t *
+prepare_pool(game_t *game)
+{
+    unsigned int worker_count = game->threads ? game->threads : 1;
+
+    if (NULL != game->hda && game->hda->worker_count != worker_count)
+        hda__release(game);
+
+    if (NULL == game->hda) {
+        game->hda = create_pool(game, worker_count);
+        if (NULL == game->hda) return NULL;
+    }
+
+    clear_pool(game->hda);
+    return game->hda;
+}
+
+
+void
+hda__release(game_t *game)
+{
+    if (NULL == game->hda) return;
+
+    release_pool(game->hda);
+    game->hda = NULL;
+}
+
+
+/* Rebuild the incumbent's route in the game's own arena, as the other searches leave it. */
+static
+solver_status_t
+adopt_route(hda_t *hda)
+{
+    game_t *game = hda->game;
+    board_t *goal = resolve_node(hda, hda->incumbent_node);
+    unsigned int length = goal->moves_from_start;
+
+    board_t **route = malloc((length + 1) * sizeof(board_t *));
+    if (NULL == route) return SOLVER_OUT_OF_MEMORY;
+
+    for (board_t *board = goal; ; board = resolve_node(hda, board->parent_index)) {
+        route[board->moves_from_start] = board;
+        if (ARENA_NO_NODE == board->parent_index) break;
+    }
+
+    /* route[0] is the start board, which is already the arena's root. */
+    for (unsigned int m = 1; m <= length; ++m) {
+        unsigned int index;
+        board_t *node = arena__alloc(game->nodes, &index);
+        if (NULL == node) {
+            free(route);
+            return SOLVER_OUT_OF_MEMORY;
+        }
+
+        *node = *route[m];
+        node->node_index = index;
+        node->parent_index = game->current_board_state->node_index;
+        game->current_board_state = node;
+    }
+
+    free(route);
+    return SOLVER_OK;
+}
+
+
+/* HDA*: Run A* across the solver's threads. */
+solver_status_t
+hda__solve(game_t *game)
+{
+    hda_t *hda = prepare_pool(game);
+    if (NULL == hda) return SOLVER_OUT_OF_MEMORY;
+
+    debug("\n-- Running HDA* Search on %u threads...\n", hda->worker_count);
+
+    /* The start board goes to its owner before any thread runs. */
+    board_t *start = game->current_board_state;
+    if (0 != accept_board(&hda->workers[owner_of(hda, start)], start)) return SOLVER_OUT_OF_MEMORY;
+
+    /* The calling thread works as worker #0. */
+    unsigned int started = 1;
+    for (; started < hda->worker_count; ++started)
+        if (0 != pthread_create(&hda->workers[started].thread, NULL,
+                                run_worker, &hda->workers[started]))
+            break;
+
+    /* Too few threads would leave some boards without an owner. */
+    if (started < hda->worker_count) fail(hda);
+    else run_worker(&hda->workers[0]);
+
+    for (unsigned int w = 1; w < started; ++w)
+        pthread_join(hda->workers[w].thread, NULL);
+
+    for (unsigned int w = 0; w < hda->worker_count; ++w) {
+        game->expansions += hda->workers[w].expansions;
+        game->other_nodes += hda->workers[w].nodes->used;
+#ifdef FN_STATS
+        stats__merge(&game->stats->values, &hda->workers[w].stats.values);
+#endif
+    }
+
+    if (atomic_load(&hda->failed)) return SOLVER_OUT_OF_MEMORY;
+    if (HDA_NO_INCUMBENT == atomic_load(&hda->incumbent_cost)) return SOLVER_NO_SOLUTION;
+
+    return adopt_route(hda);
+}
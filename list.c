@@ -28,17 +28,16 @@ list__destroy(list_t **p_list,
     if (NULL == p_list || NULL == *p_list) return;
 
     list_t *list = *p_list;
-    if (!deep) goto finalize;
 
+    /* The list cells are always released; their payloads only when 'deep'. */
     list_node_t *node = list->head;
     while (NULL != node) {
         list_node_t *last_node = node;
-        free(node->node);
+        if (deep) free(node->node);
         node = node->next;
         free(last_node);
     }
 
-finalize:
     free(list);
     *p_list = NULL;
     return;
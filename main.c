@@ -11,302 +11,611 @@
 
 #include "game.h"
 
+#include <ctype.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <time.h>
+#include <unistd.h>
 
 
-/* A*: Calculate a list of all possible next states from the current one. */
+/* The searches which can be run, in the order they are reported. */
+typedef struct
+{
+    const char *name;      /* Name given to '-s'. */
+    const char *label;     /* Row label in the summary. */
+    const char *title;     /* How the search is announced. */
+    const char *abbrev;    /* Short name in the per-search summary. */
+    solver_algorithm_t algorithm;
+} search_t;
+
+static const search_t searches[] = {
+    { "astar",      "A-Star",               "A* search",                         "A*",      SOLVER_ASTAR      },
+    { "bnb",        "Branch and Bound",     "branch and bound",                  "B&B",     SOLVER_BNB        },
+    { "retro",      "Retrograde",           "retrograde table",                  "Retro",   SOLVER_RETRO      },
+    { "hda",        "Parallel A-Star",      "parallel A*",                       "HDA*",    SOLVER_HDA        },
+    { "ida",        "IDA-Star",             "IDA* search",                       "IDA*",    SOLVER_IDA        },
+    { "bidi",       "Bidirectional",        "bidirectional uniform-cost search", "Bidi",    SOLVER_BIDI       },
+    { "bidi-astar", "Bidirectional A-Star", "bidirectional A*",                  "Bidi A*", SOLVER_BIDI_ASTAR },
+    { "ara",        "Anytime A-Star",       "anytime repairing A*",              "ARA*",    SOLVER_ARA        },
+    { "sma",        "SMA-Star",             "memory-bounded A*",                 "SMA*",    SOLVER_SMA        },
+};
+#define SEARCH_COUNT  (sizeof(searches) / sizeof(searches[0]))
+
+
+/* Print command-line usage. */
 static
 void
-astar__get_next_possible_moves(game_t *game)
+usage(const char *program)
 {
-    /*
-     * Quick notes about the rules for Four Knights:
-     * - The middle space (b2 / #4) is never used as a reachable location.
-     * - Possible state transitions follow a map, but need to only
-     *   be allowed if the destination is EMPTY.
-     * - Knights can usually only ever move to two spaces from current.
-     */
-    board_t *current_state = game->current_board_state;
-    for (int i = 0; i < BOARD_SIZE; ++i) {
-        /* No moves generated from an empty slot. */
-        if (EMPTY == current_state->s[i]) continue;
-        /* No moves from position #4 (b2). */
-        if (4 == i) continue;
-
-        /* For each occupied slot, check the allowable destinations
-         * in the graph. If EMPTY, create a new board state from the
-         * moved knight. */
-        for (int j = 0; j < MAX_POSSIBLE_MOVES; ++j) {
-            /* If the destination slot is occupied, the move cannot be completed. */
-            if (EMPTY != current_state->s[move[i].destinations[j]]) continue;
-
-            /* Create a new board state from the expansion. */
-            board_t *new_state = calloc(1, sizeof(board_t));
-            memcpy(new_state, current_state, sizeof(board_t));
-
-            /* Move the piece by getting what the old space held
-             * and applying it to the new space. The old space becomes EMPTY. */
-            board_space_state_t old_state = new_state->s[i];
-            new_state->s[i] = EMPTY;
-            new_state->s[move[i].destinations[j]] = old_state;
-
-            /* Track the parent state we expanded from. */
-            new_state->parent_state = current_state;
-            new_state->moves_from_start = current_state->moves_from_start + 1;
-
-            /* Make sure this new possible state has not already been visited. */
-            unsigned int state_code = get_state_code(new_state);
-            if (0 == list__contains(game->visited_boards,
-                                    &state_code,
-                                    sizeof(unsigned int)))
-            {
-                debug("\nDiscovered new possible move:\n");
-                print_board(new_state);
-
-                /*
-                 * F(x) is the total cost estimate.
-                 * G(x) is the amount of moves away from the origin for this expansion.
-                 * H(x) is the heuristic (or 'closeness') measurement.
-                 */
-                unsigned int h_x = get_heuristic(new_state, game);
-                unsigned int g_x = new_state->moves_from_start;
-                unsigned int f_x = g_x + h_x;
-
-                debug("Stats:\tf(x) = %u\tg(x) = %u\th(x) = %u\n", f_x, g_x, h_x);
-                debug("\tUnseen board hash recorded: %u\n", state_code);
-
-                /* Be sure to insert the board state into the priority-based queue structure. */
-                queue__insert(game->priority_queue,
-                              new_state,
-                              f_x,
-                              g_x,
-                              h_x);
-
-                /*
-                 * Notice that A* doesn't track every board state as visited;
-                 * only the ones it chooses from the min_queue.
-                 * Instead, it can rely on the H(x) value to guide it to the
-                 * end state that represents a completed game.
-                 * */
-            }
+    fprintf(stderr, "Usage: %s [-q heap|bucket] [-s solver[,solver...]] [-f file] [-g] [-p knights] [-w weight] [-d microseconds] [-m nodes] [-t file] [-b file [-j threads]]\n", program);
+    fprintf(stderr, "  -q    Open-list implementation (default: heap).\n");
+    fprintf(stderr, "  -s    Searches to run, in order (default: astar,bnb).\n");
+    fprintf(stderr, "        One of:");
+    for (unsigned int i = 0; i < SEARCH_COUNT; ++i)
+        fprintf(stderr, " %s", searches[i].name);
+    fprintf(stderr, "\n");
+    fprintf(stderr, "  -f    Play the start and goal boards drawn in a file, instead of the classic puzzle.\n");
+    fprintf(stderr, "  -g    Precompute the board's whole state graph and search on it.\n");
+    fprintf(stderr, "  -p    Guide astar, ida, hda, ara and sma with pattern databases over groups of this many knights.\n");
+    fprintf(stderr, "  -w    Weight on h(x) of ara's first, quick search (default: 3).\n");
+    fprintf(stderr, "  -d    Time ara may take, in microseconds; it returns its best route so far (default: until optimal).\n");
+    fprintf(stderr, "  -m    Nodes sma may keep at once (default: 65536).\n");
+    fprintf(stderr, "  -t    Record a binary trace of the searches (builds from 'make trace' only).\n");
+    fprintf(stderr, "  -b    Solve every '<start> <goal>' puzzle listed in a file ('-' for stdin).\n");
+    fprintf(stderr, "  -j    Worker threads for '-b' and 'hda' (default: one per online CPU).\n");
+}
+
+
+#ifdef FN_STATS
+static const char *stat_names[SOLVER_STAT_COUNT] = {
+    [SOLVER_STAT_SUCCESSORS] = "successors",
+    [SOLVER_STAT_DUPLICATES] = "duplicates",
+    [SOLVER_STAT_PUSHES]     = "pushes",
+    [SOLVER_STAT_POPS]       = "pops",
+    [SOLVER_STAT_OPEN_PEAK]  = "open_peak",
+    [SOLVER_STAT_BYTES]      = "bytes",
+};
+
+static const char *phase_names[SOLVER_PHASE_COUNT] = {
+    [SOLVER_PHASE_MOVES]     = "moves",
+    [SOLVER_PHASE_HASH]      = "hash",
+    [SOLVER_PHASE_HEURISTIC] = "heuristic",
+    [SOLVER_PHASE_QUEUE]     = "queue",
+};
+
+
+/* Write the instrumentation of each search as CSV on stderr, one row per value. */
+static
+void
+dump_stats(const search_t **selected,
+           const solver_stats_t *stats,
+           unsigned int selected_count)
+{
+    fflush(stdout);
+    fprintf(stderr, "Search, Statistic, Value\n");
+
+    for (unsigned int s = 0; s < selected_count; ++s) {
+        for (unsigned int c = 0; c < SOLVER_STAT_COUNT; ++c)
+            fprintf(stderr, "%s, %s, %llu\n", selected[s]->name, stat_names[c], stats[s].counter[c]);
+
+        for (unsigned int p = 0; p < SOLVER_PHASE_COUNT; ++p) {
+            fprintf(stderr, "%s, %s_cycles, %llu\n", selected[s]->name, phase_names[p], stats[s].cycles[p]);
+            fprintf(stderr, "%s, %s_calls, %llu\n", selected[s]->name, phase_names[p], stats[s].calls[p]);
         }
     }
 }
+#endif
 
 
-/* Branch & Bound: Calculate a list of all possible next states from the current one. */
+/* Report each route the anytime search finds on its way to the best. */
 static
 void
-bnb__get_next_possible_moves(game_t *game)
+print_improvement(const solver_result_t *result,
+                  void *context)
+{
+    const search_t *search = context;
+
+    fprintf(stderr, "%s: %u moves, at most %.3f times the optimum, after %u expansions.\n",
+            search->abbrev, result->move_count, result->bound, result->expansions);
+}
+
+
+/* Turn a comma-separated '-s' argument into a list of searches.
+ *  Returns the number selected, or 0 if any name is unknown. */
+static
+unsigned int
+parse_searches(char *names,
+               const search_t **selected,
+               unsigned int limit)
+{
+    unsigned int count = 0;
+
+    for (char *name = strtok(names, ","); NULL != name; name = strtok(NULL, ",")) {
+        unsigned int i = 0;
+        while (i < SEARCH_COUNT && 0 != strcmp(name, searches[i].name)) ++i;
+
+        if (i == SEARCH_COUNT || count == limit) return 0;
+        selected[count++] = &searches[i];
+    }
+
+    return count;
+}
+
+
+/* Read a start board and a goal board of the same shape.
+ *  Returns the text after the goal, or NULL. */
+static
+const char *
+parse_puzzle(const char *text,
+             solver_board_t *board,
+             solver_instance_t *instance)
 {
-    /* Same rules apply as in the A* function. See that function for most annotations. */
-    board_t *current_state = game->current_board_state;
-    for (int i = 0; i < BOARD_SIZE; ++i) {
-        if (EMPTY == current_state->s[i]) continue;
-        if (4 == i) continue;
-
-        for (int j = 0; j < MAX_POSSIBLE_MOVES; ++j) {
-            /* If the destination slot is occupied, the move cannot be completed. */
-            if (EMPTY != current_state->s[move[i].destinations[j]]) continue;
-
-            /* Create a new board state from the expansion. */
-            board_t *new_state = calloc(1, sizeof(board_t));
-            memcpy(new_state, current_state, sizeof(board_t));
-
-            /* Move the piece by getting what the old space held
-             * and applying it to the new space. The old space becomes EMPTY. */
-            board_space_state_t old_state = new_state->s[i];
-            new_state->s[i] = EMPTY;
-            new_state->s[move[i].destinations[j]] = old_state;
-
-            /* Track the parent state we expanded from. */
-            new_state->parent_state = current_state;
-            new_state->moves_from_start = current_state->moves_from_start + 1;
-
-            /* Make sure this new possible state has not already been visited. */
-            unsigned int state_code = get_state_code(new_state);
-            if (0 == list__contains(game->visited_boards,
-                                    &state_code,
-                                    sizeof(unsigned int))) {
-                /* Notice how B&B is not checking whether a sub-tree was already expanded. */
-                debug("\nDiscovered new possible move:\n");
-                print_board(new_state);
-
-                /*
-                 * F(x) is the total cost estimate.
-                 * G(x) is the amount of moves away from the origin for this expansion.
-                 * H(x) is not defined with branch and bound.
-                 */
-                unsigned int h_x = 0;
-                unsigned int g_x = new_state->moves_from_start;
-                unsigned int f_x = g_x + h_x;
-
-                debug("Stats:\tf(x) = %u\tg(x) = %u\th(x) = %u\n", f_x, g_x, h_x);
-
-                queue__insert(game->priority_queue,
-                              new_state,
-                              f_x,
-                              g_x,
-                              h_x);
-
-                /* Track this board state as 'visited' in BnB. */
-                unsigned int *state = (unsigned int *)malloc(sizeof(unsigned int));
-                *state = get_state_code(new_state);
-                list__insert(game->visited_boards, (node_t)state);
-            }
+    solver_board_t goal_board;
+
+    if (NULL == (text = solver__read_board(text, board, instance->start))
+        || NULL == (text = solver__read_board(text, &goal_board, instance->goal)))
+        return NULL;
+
+    if (board->rows != goal_board.rows || board->columns != goal_board.columns)
+        return NULL;
+
+    /* A side may leave its later knights out of one board, but not of both. */
+    board->knights_per_side = MAX(board->knights_per_side, goal_board.knights_per_side);
+    return text;
+}
+
+
+/* Load a batch of puzzles, one per line. Blank lines and '#' comments are skipped.
+ *  Every puzzle must share the first one's board, which is stored in 'board'.
+ *  Returns the number loaded (with *instances allocated), or -1 on any error. */
+static
+int
+load_instances(const char *path,
+               solver_board_t *board,
+               solver_instance_t **instances)
+{
+    FILE *file = (0 == strcmp(path, "-")) ? stdin : fopen(path, "r");
+    if (NULL == file) {
+        fprintf(stderr, "Cannot open '%s'.\n", path);
+        return -1;
+    }
+
+    unsigned int count = 0, capacity = 64, line_number = 0;
+    char line[256];
+    *instances = malloc(capacity * sizeof(solver_instance_t));
+
+    while (NULL != *instances && NULL != fgets(line, sizeof(line), file)) {
+        ++line_number;
+
+        char *comment = strchr(line, '#');
+        if (NULL != comment) *comment = '\0';
+
+        const char *text = line;
+        while (isspace((unsigned char)*text)) ++text;
+        if ('\0' == *text) continue;
+
+        if (count == capacity) {
+            solver_instance_t *grown = realloc(*instances, 2 * capacity * sizeof(solver_instance_t));
+            if (NULL == grown) break;
+            *instances = grown;
+            capacity *= 2;
+        }
+
+        solver_instance_t *instance = &(*instances)[count];
+        solver_board_t shape;
+        if (NULL == (text = parse_puzzle(text, &shape, instance))) {
+            fprintf(stderr, "%s:%u: expected '<start> <goal>' boards.\n", path, line_number);
+            goto failed;
+        }
+
+        if (0 == count) {
+            *board = shape;
+        } else if (shape.rows != board->rows || shape.columns != board->columns
+                   || shape.knights_per_side != board->knights_per_side) {
+            fprintf(stderr, "%s:%u: every puzzle of a batch must use the same board.\n",
+                    path, line_number);
+            goto failed;
         }
+
+        while (isspace((unsigned char)*text)) ++text;
+        if ('\0' != *text) {
+            fprintf(stderr, "%s:%u: unexpected text after the goal board.\n", path, line_number);
+            goto failed;
+        }
+
+        ++count;
+    }
+
+    if (NULL == *instances || !feof(file)) {
+        fprintf(stderr, "Failed to read the batch from '%s'.\n", path);
+        goto failed;
+    }
+
+    if (stdin != file) fclose(file);
+    return (int)count;
+
+failed:
+    if (stdin != file) fclose(file);
+    free(*instances);
+    *instances = NULL;
+    return -1;
+}
+
+
+/* Load one puzzle drawn as print_board() shows it: the start board, a
+ *  blank line, then the goal board. Returns nonzero on any error. */
+static
+int
+load_puzzle(const char *path,
+            solver_board_t *board,
+            solver_instance_t *instance)
+{
+    FILE *file = fopen(path, "r");
+    if (NULL == file) {
+        fprintf(stderr, "Cannot open '%s'.\n", path);
+        return 1;
+    }
+
+    char text[1024];
+    size_t length = fread(text, 1, sizeof(text) - 1, file);
+    int complete = feof(file);
+    fclose(file);
+    text[length] = '\0';
+
+    const char *rest = complete ? parse_puzzle(text, board, instance) : NULL;
+    if (NULL != rest)
+        while (isspace((unsigned char)*rest)) ++rest;
+
+    if (NULL == rest || '\0' != *rest) {
+        fprintf(stderr, "%s: expected a start board and a goal board, separated by a blank line.\n", path);
+        return 1;
     }
+
+    return 0;
 }
 
 
+/* Short status names for the batch report. */
+static const char *status_names[] = {
+    [SOLVER_OK]            = "ok",
+    [SOLVER_INVALID_BOARD] = "invalid",
+    [SOLVER_NO_SOLUTION]   = "unsolvable",
+    [SOLVER_OUT_OF_MEMORY] = "out-of-memory",
+    [SOLVER_TIMED_OUT]     = "timed-out",
+};
+
+
+/* Solve a whole batch with each selected search and report every instance. */
+static
+int
+run_batch(const char *path,
+          const search_t **selected,
+          unsigned int selected_count,
+          queue_kind_t queue_kind,
+          unsigned int threads,
+          int use_graph,
+          unsigned int pattern_knights,
+          double weight,
+          unsigned long long budget_us,
+          unsigned int node_budget)
+{
+    solver_board_t board;
+    solver_instance_t *instances;
+    int count = load_instances(path, &board, &instances);
+    if (count < 0) return 1;
+
+    solver_batch_result_t *results = calloc(count ? count : 1, sizeof(solver_batch_result_t));
+    if (NULL == results) {
+        fprintf(stderr, "Failed to allocate the batch results.\n");
+        free(instances);
+        return 1;
+    }
+
+    /* Every worker's solver is set up like this one. */
+    solver_t *prototype = solver__create_board(&board, queue_kind);
+    if (NULL == prototype) {
+        fprintf(stderr, "Failed to create a solver for a %ux%u board with %u knights a side.\n",
+                board.rows, board.columns, board.knights_per_side);
+        free(results);
+        free(instances);
+        return 1;
+    }
+
+    if (0 != solver__set_pattern_groups(prototype, pattern_knights)) {
+        fprintf(stderr, "Pattern databases over %u knights are too large for a %ux%u board.\n",
+                pattern_knights, board.rows, board.columns);
+        solver__destroy(&prototype);
+        free(results);
+        free(instances);
+        return 1;
+    }
+    solver__set_anytime(prototype, weight, budget_us, NULL, NULL);
+    solver__set_memory_limit(prototype, node_budget);
+
+    /* One graph serves every worker and every search. */
+    solver_graph_t *graph = NULL;
+    if (use_graph && count > 0) {
+        struct timespec start, end;
+
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        graph = solver__create_graph(&board);
+        clock_gettime(CLOCK_MONOTONIC, &end);
+
+        if (NULL == graph) {
+            fprintf(stderr, "Failed to build the state graph for a %ux%u board with %u knights a side.\n",
+                    board.rows, board.columns, board.knights_per_side);
+            solver__destroy(&prototype);
+            free(results);
+            free(instances);
+            return 1;
+        }
+
+        solver__use_graph(prototype, graph);
+        fprintf(stderr, "State graph built in %f seconds.\n",
+                (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9);
+    }
+
+#ifdef FN_STATS
+    solver_stats_t stats[16] = { 0 };
+#endif
+
+    PRINT("Type, Instance, Status, Moves, Expansions, Route\n");
+    for (unsigned int s = 0; s < selected_count; ++s) {
+        struct timespec start, end;
+
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        solver_status_t status = solver__solve_batch(prototype,
+                                                     instances, count,
+                                                     selected[s]->algorithm,
+                                                     threads,
+                                                     results);
+        clock_gettime(CLOCK_MONOTONIC, &end);
+
+        if (SOLVER_OK != status) {
+            fprintf(stderr, "%s batch failed: %s\n",
+                    selected[s]->abbrev, solver__status_message(status));
+            solver__destroy(&prototype);
+            solver__destroy_graph(&graph);
+            free(results);
+            free(instances);
+            return 1;
+        }
+
+        unsigned int solved = 0;
+        for (int i = 0; i < count; ++i) {
+            const solver_batch_result_t *r = &results[i];
+            solved += (SOLVER_OK == r->status);
+#ifdef FN_STATS
+            stats__merge(&stats[s], &r->stats);
+#endif
+
+            PRINT("%s, %d, %s, %u, %u, ",
+                  selected[s]->label, i + 1,
+                  status_names[r->status],
+                  r->move_count, r->expansions);
+
+            /* Each move as knight, origin and destination, e.g. 'Ba3-b1'. Files
+             * are lettered from the left, ranks numbered from the bottom. */
+            for (unsigned int m = 0; m < r->move_count; ++m)
+                PRINT("%s%c%c%u-%c%u", m ? " " : "",
+                      solver__knight_glyph(&board, r->moves[m].knight),
+                      'a' + r->moves[m].from % board.columns,
+                      board.rows - r->moves[m].from / board.columns,
+                      'a' + r->moves[m].to % board.columns,
+                      board.rows - r->moves[m].to / board.columns);
+            PRINT("\n");
+        }
+
+        double seconds = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+        fprintf(stderr, "%s: solved %u of %d puzzles in %f seconds on %u threads (%.0f puzzles/second)\n",
+                selected[s]->abbrev, solved, count, seconds, threads,
+                seconds > 0 ? count / seconds : 0.0);
+
+        solver__release_batch(results, count);
+    }
+
+#ifdef FN_STATS
+    dump_stats(selected, stats, selected_count);
+#endif
+
+    solver__destroy(&prototype);
+    solver__destroy_graph(&graph);
+    free(results);
+    free(instances);
+    return 0;
+}
+
 
 /* Main program method. Run simulations and report. */
 int
-main()
+main(int argc,
+     char **argv)
 {
     clock_t start, end;
-    double astar_time, bnb_time;
-    unsigned int astar_expansions, bnb_expansions;
-    game_t _four_knights = {
-        .current_board_state = (board_t *)calloc(1, sizeof(board_t)),
-        .initial_board_state = {
-            .a1 = BLACK_1,
-            .a2 = EMPTY,
-            .a3 = BLACK_2,
-            .b1 = EMPTY,
-            .b2 = EMPTY,
-            .b3 = EMPTY,
-            .c1 = WHITE_1,
-            .c2 = EMPTY,
-            .c3 = WHITE_2,
-            .moves_from_start = 0,
-            .parent_state = NULL
+    solver_board_t board = { 3, 3, 2 };
+    solver_instance_t puzzle = {
+        .start = {
+            BLACK_1, EMPTY, BLACK_2,
+            EMPTY,   EMPTY, EMPTY,
+            WHITE_1, EMPTY, WHITE_2
         },
-        .goal_board_state = {
-            .a1 = WHITE_2,
-            .a2 = EMPTY,
-            .a3 = WHITE_1,
-            .b1 = EMPTY,
-            .b2 = EMPTY,
-            .b3 = EMPTY,
-            .c1 = BLACK_2,
-            .c2 = EMPTY,
-            .c3 = BLACK_1
+        .goal = {
+            WHITE_2, EMPTY, WHITE_1,
+            EMPTY,   EMPTY, EMPTY,
+            BLACK_2, EMPTY, BLACK_1
         },
     };
 
-    /* This is stupid, but w/e. */
-    four_knights = calloc(sizeof(game_t), 1);
-    memcpy(four_knights, &_four_knights, sizeof(game_t));
-
-    /* OK, start the simulations. */
-    debug("\n\n=~=~= Four Knights Puzzle Simulator =~=~=\n\n");
-    debug("\n-- Initializing game board...\n");
-    reset_game(four_knights);
-    print_board(four_knights->current_board_state);
-    debug( "\n-- Game goal state...\n");
-    print_board(&four_knights->goal_board_state);
-
-
-    /**************************************************************
-     *
-     *    A-Star...
-     *
-     **************************************************************/
-    debug("\n-- Running A* Search for best solution...\n");
-    start = clock();
-    while (0 != check_game(four_knights)) {
-        /* Increase the counter of times we've expanded tree nodes. */
-        ++four_knights->expansions;
-
-        /* Add the next set of moves to the search list. */
-        astar__get_next_possible_moves(four_knights);
-
-        /* Select the lowest-cost path according to the set of expanded moves. */
-        queue_object_t queue_obj = queue__get_min(four_knights->priority_queue);
-        if (NULL == queue_obj.item) {
-            fprintf(stderr, "Uh oh! Looks like there are no more possibilities.\n");
-            exit(1);
+    const search_t *selected[16] = { &searches[0], &searches[1] };
+    unsigned int selected_count = 2;
+    double times[16];
+    unsigned int expansions[16];
+#ifdef FN_STATS
+    solver_stats_t stats[16];
+#endif
+
+    queue_kind_t queue_kind = QUEUE_BINARY_HEAP;
+    const char *batch_path = NULL;
+    const char *board_path = NULL;
+    const char *trace_path = NULL;
+    int use_graph = 0;
+    long pattern_knights = 0;
+    double weight = 3.0;
+    long long budget_us = 0;
+    long node_budget = 1L << 16;
+    long threads = sysconf(_SC_NPROCESSORS_ONLN);
+    int opt;
+    while (-1 != (opt = getopt(argc, argv, "q:s:f:gp:w:d:m:t:b:j:"))) {
+        switch (opt) {
+            case 'q':
+                if (0 == strcmp(optarg, "heap")) queue_kind = QUEUE_BINARY_HEAP;
+                else if (0 == strcmp(optarg, "bucket")) queue_kind = QUEUE_BUCKET;
+                else { usage(argv[0]); return 1; }
+                break;
+            case 's':
+                selected_count = parse_searches(optarg, selected, 16);
+                if (0 == selected_count) { usage(argv[0]); return 1; }
+                break;
+            case 'f':
+                board_path = optarg;
+                break;
+            case 'g':
+                use_graph = 1;
+                break;
+            case 'p':
+                pattern_knights = strtol(optarg, NULL, 10);
+                if (pattern_knights < 1) { usage(argv[0]); return 1; }
+                break;
+            case 'w':
+                weight = strtod(optarg, NULL);
+                if (weight < 1.0) { usage(argv[0]); return 1; }
+                break;
+            case 'd':
+                budget_us = strtoll(optarg, NULL, 10);
+                if (budget_us < 1) { usage(argv[0]); return 1; }
+                break;
+            case 'm':
+                node_budget = strtol(optarg, NULL, 10);
+                if (node_budget < 2 || node_budget > 0x7FFFFFFF) { usage(argv[0]); return 1; }
+                break;
+            case 't':
+                trace_path = optarg;
+                break;
+            case 'b':
+                batch_path = optarg;
+                break;
+            case 'j':
+                threads = strtol(optarg, NULL, 10);
+                if (threads < 1) { usage(argv[0]); return 1; }
+                break;
+            default:
+                usage(argv[0]);
+                return 1;
         }
+    }
 
-        /* Set the current board state to the plucked entry. */
-        four_knights->current_board_state = queue_obj.item;
+    if (NULL != batch_path && NULL != trace_path) {
+        fprintf(stderr, "Traces are recorded for a single puzzle, not a batch.\n");
+        return 1;
+    }
+
+    if (NULL != batch_path)
+        return run_batch(batch_path, selected, selected_count, queue_kind,
+                         threads > 0 ? (unsigned int)threads : 1, use_graph,
+                         (unsigned int)pattern_knights, weight,
+                         (unsigned long long)budget_us, (unsigned int)node_budget);
 
-        /* Track this board state as 'visited'. */
-        unsigned int *state = (unsigned int *)malloc(sizeof(unsigned int));
-        *state = get_state_code((board_t *)queue_obj.item);
-        list__insert(four_knights->visited_boards, (node_t)state);
+    if (NULL != board_path && 0 != load_puzzle(board_path, &board, &puzzle))
+        return 1;
 
-        /* Print out the route selection for expansion. */
-        debug("\n === Selected Route w/ Cost %d ===\n", queue_obj.F);
-        print_board(four_knights->current_board_state);
+    solver_t *solver = solver__create_board(&board, queue_kind);
+    if (NULL == solver) {
+        fprintf(stderr, "Failed to create a solver for a %ux%u board with %u knights a side.\n",
+                board.rows, board.columns, board.knights_per_side);
+        return 1;
+    }
+    solver__set_threads(solver, threads > 0 ? (unsigned int)threads : 1);
+    solver__set_memory_limit(solver, (unsigned int)node_budget);
+
+    if (0 != solver__set_pattern_groups(solver, (unsigned int)pattern_knights)) {
+        fprintf(stderr, "Pattern databases over %ld knights are too large for a %ux%u board.\n",
+                pattern_knights, board.rows, board.columns);
+        solver__destroy(&solver);
+        return 1;
     }
 
-    /* Print a post-op summary. */
-    end = clock();
-    astar_expansions = four_knights->expansions;
-    astar_time = ((double)(end - start)) / CLOCKS_PER_SEC;
-    print_final_game_solution(four_knights);
-    debug("\n==*=*=*=*=*=*=*=*=*=*=*==\nNice! You won!!!\n");
-    debug("\tTree Expansions with A*: %u\n\tTime taken: %f seconds\n\n",
-           astar_expansions,
-           astar_time);
-
-
-    /**************************************************************
-     *
-     *    BRANCH AND BOUND...
-     *      No extended list filtering. Exhaustive.
-     *
-     **************************************************************/
-    /* Reset the game and go for branch and bound searching. */
-    debug("\n\n\n========================================\nPlaying the game with branch and bound...\n");
-    debug("\n-- Initializing game board...\n");
-    reset_game(four_knights);
-    print_board(four_knights->current_board_state);
-    debug( "\n-- Game goal state...\n");
-    print_board(&four_knights->goal_board_state);
-
-    start = clock();
-    while (0 != check_game(four_knights)) {
-        /* Increase the counter of times we've expanded tree nodes. */
-        ++four_knights->expansions;
-
-        /* Add the next set of moves to the search list. */
-        bnb__get_next_possible_moves(four_knights);
-
-        /* Select the lowest-cost path according to the set of expanded moves. */
-        queue_object_t queue_obj = queue__get_min(four_knights->priority_queue);
-        if (NULL == queue_obj.item) {
-            fprintf(stderr, "Uh oh! Somehow got a NULL lowest cost.\n");
-            exit(1);
+    solver_graph_t *graph = NULL;
+    if (use_graph) {
+        graph = solver__create_graph(&board);
+        if (NULL == graph) {
+            fprintf(stderr, "Failed to build the state graph for a %ux%u board with %u knights a side.\n",
+                    board.rows, board.columns, board.knights_per_side);
+            solver__destroy(&solver);
+            return 1;
         }
 
-        /* Set the current board state to the plucked entry. */
-        four_knights->current_board_state = queue_obj.item;
+        solver__use_graph(solver, graph);
+    }
 
-        /* Print out the route selection for expansion. */
-        debug("\n === Selected Route w/ Cost %d ===\n", queue_obj.F);
-        print_board(four_knights->current_board_state);
+    if (NULL != trace_path && 0 != solver__set_trace(solver, trace_path)) {
+        fprintf(stderr, "Cannot record a trace to '%s'; tracing needs a 'make trace' build.\n", trace_path);
+        solver__destroy(&solver);
+        solver__destroy_graph(&graph);
+        return 1;
     }
 
-    /* Print a post-op summary. */
-    end = clock();
-    bnb_expansions = four_knights->expansions;
-    bnb_time = ((double)(end - start)) / CLOCKS_PER_SEC;
-    print_final_game_solution(four_knights);
-    debug("\n==*=*=*=*=*=*=*=*=*=*=*==\nNice! You won!!!\n");
-    debug("\tTree Expansions with B&B: %u\n\tTime taken: %f seconds\n\n",
-           bnb_expansions,
-           bnb_time);
+    /* OK, start the simulations. */
+    debug("\n\n=~=~= Four Knights Puzzle Simulator =~=~=\n\n");
+    for (unsigned int s = 0; s < selected_count; ++s) {
+        /* The solver resets itself before each search. */
+        if (s > 0)
+            debug("\n\n\n========================================\nPlaying the game with %s...\n",
+                  selected[s]->title);
+
+        solver__set_anytime(solver, weight, (unsigned long long)budget_us,
+                            print_improvement, (void *)selected[s]);
+
+        solver_result_t result;
+        start = clock();
+        solver_status_t status = solver__solve(solver,
+                                               selected[s]->algorithm,
+                                               puzzle.start,
+                                               puzzle.goal,
+                                               &result);
+        end = clock();
+
+        if (SOLVER_OK != status) {
+            fprintf(stderr, "%s gave up after %u expansions: %s\n",
+                    selected[s]->abbrev,
+                    result.expansions,
+                    solver__status_message(status));
+            solver__destroy(&solver);
+            solver__destroy_graph(&graph);
+            return 1;
+        }
+
+        /* Print a post-op summary. */
+        expansions[s] = result.expansions;
+#ifdef FN_STATS
+        stats[s] = result.stats;
+#endif
+        times[s] = ((double)(end - start)) / CLOCKS_PER_SEC;
+        debug("\n==*=*=*=*=*=*=*=*=*=*=*==\nNice! You won!!!\n");
+        debug("\tTree Expansions with %s: %u\n\tTime taken: %f seconds\n\n",
+               selected[s]->abbrev,
+               expansions[s],
+               times[s]);
+    }
 
     /* All done! */
     PRINT("\nType, Time (microseconds), Expansions\n");
-    PRINT("A-Star, %f, %u\n", astar_time * 1000 * 1000, astar_expansions);
-    PRINT("Branch and Bound, %f, %u\n", bnb_time * 1000 * 1000, bnb_expansions);
-    reset_game(four_knights);
+    for (unsigned int s = 0; s < selected_count; ++s)
+        PRINT("%s, %f, %u\n", selected[s]->label, times[s] * 1000 * 1000, expansions[s]);
+#ifdef FN_STATS
+    dump_stats(selected, stats, selected_count);
+#endif
+    solver__destroy(&solver);
+    solver__destroy_graph(&graph);
     return 0;
 }
@@ -0,0 +1,65 @@
+/*
+ * mpsc.c
+ *
+ *  Implementation of the intrusive multi-producer, single-consumer queue.
+ */
+
+#include "mpsc.h"
+
+#include <stddef.h>
+
+
+void
+mpsc__init(mpsc_t *queue)
+{
+    atomic_init(&queue->stub.next, NULL);
+    atomic_init(&queue->head, &queue->stub);
+    queue->tail = &queue->stub;
+}
+
+
+/* Any thread. */
+void
+mpsc__push(mpsc_t *queue,
+           mpsc_node_t *node)
+{
+    atomic_store_explicit(&node->next, NULL, memory_order_relaxed);
+
+    mpsc_node_t *previous = atomic_exchange_explicit(&queue->head, node, memory_order_acq_rel);
+    atomic_store_explicit(&previous->next, node, memory_order_release);
+}
+
+
+/* Consumer only. Returns the oldest node, or NULL if there is none yet.
+ *  A push still linking itself in shows up as NULL until it finishes. */
+mpsc_node_t *
+mpsc__pop(mpsc_t *queue)
+{
+    mpsc_node_t *tail = queue->tail;
+    mpsc_node_t *next = atomic_load_explicit(&tail->next, memory_order_acquire);
+
+    /* Step over the stub, which only keeps the list non-empty. */
+    if (&queue->stub == tail) {
+        if (NULL == next) return NULL;
+
+        queue->tail = next;
+        tail = next;
+        next = atomic_load_explicit(&tail->next, memory_order_acquire);
+    }
+
+    if (NULL != next) {
+        queue->tail = next;
+        return tail;
+    }
+
+    if (tail != atomic_load_explicit(&queue->head, memory_order_acquire)) return NULL;
+
+    /* 'tail' is the last node: put the stub behind it so it can be handed out. */
+    mpsc__push(queue, &queue->stub);
+
+    next = atomic_load_explicit(&tail->next, memory_order_acquire);
+    if (NULL == next) return NULL;
+
+    queue->tail = next;
+    return tail;
+}
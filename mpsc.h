@@ -0,0 +1,50 @@
+/*
+ * mpsc.h
+ *
+ *  Definitions for a lock-free multi-producer, single-consumer queue.
+ */
+
+#ifndef FOURKNIGHTS_MPSC_H
+#define FOURKNIGHTS_MPSC_H
+
+#include <stdatomic.h>
+
+
+/* Link embedded at the start of anything passed through the queue. */
+typedef struct _mpsc_node mpsc_node_t;
+struct _mpsc_node {
+    _Atomic(mpsc_node_t *) next;
+};
+
+/*
+ * An intrusive queue after Vyukov: producers only swap themselves in as
+ * the new 'head', and the single consumer walks from 'tail'. A push is one
+ * atomic exchange and never waits on another thread. The two ends sit on
+ * separate cache lines so senders don't disturb the receiver.
+ */
+typedef struct
+{
+    _Alignas(64) _Atomic(mpsc_node_t *) head;
+    _Alignas(64) mpsc_node_t *tail;
+    mpsc_node_t stub;
+} mpsc_t;
+
+
+void
+mpsc__init(
+    mpsc_t *queue
+);
+
+void
+mpsc__push(
+    mpsc_t *queue,
+    mpsc_node_t *node
+);
+
+mpsc_node_t *
+mpsc__pop(
+    mpsc_t *queue
+);
+
+
+#endif   /* FOURKNIGHTS_MPSC_H */
@@ -0,0 +1,199 @@
+/*
+ * pattern.c
+ *
+ *  Additive pattern databases: a stronger h(x) for the heuristic searches.
+ *
+ *  The knights are split into disjoint groups. For each group, a table
+ *  holds the fewest moves that group's knights need to reach their goal
+ *  squares with every other knight lifted off the board. Knights still
+ *  block one another within a group, which is exactly what the
+ *  per-knight distances miss.
+ *
+ *  Every move of a solution moves a knight of exactly one group, and
+ *  those moves on their own are a legal route for that group on the
+ *  emptier board. So no group's entry counts a move that another's does,
+ *  and the entries add up to an admissible, consistent h(x). Each entry
+ *  is also raised to at least its knights' own distances, so the sum is
+ *  never below the per-knight distance sum (the special case of groups
+ *  of one), even where entries saturate.
+ *
+ *  The tables depend on the goal, and are rebuilt when it changes, each
+ *  by one breadth-first search out from the goal's pattern.
+ */
+
+#include "game.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+
+int
+pattern__configure(game_t *game,
+                   unsigned int knights)
+{
+    const layout_t *layout = &game->layout;
+    patterns_t *patterns = &game->patterns;
+
+    /* Larger groups hold whole black/white pairs (see below): round odd sizes down. */
+    if (knights > layout->pieces) knights = layout->pieces;
+    if (knights > 1) knights &= ~1U;
+
+    /* A group's table has slot_count^knights entries. */
+    unsigned long long table_size = 1;
+    for (unsigned int j = 0; j < knights; ++j) {
+        table_size *= layout->slot_count;
+        if (table_size > DENSE_STATE_LIMIT) return 1;
+    }
+
+    for (unsigned int g = 0; g < MAX_KNIGHTS; ++g)
+        free(patterns->distance[g]);
+    memset(patterns, 0, sizeof(patterns_t));
+
+    if (0 == knights) return 0;
+    patterns->knights = knights;
+
+    /*
+     * Knights are grouped in the order B, W, b, w, C, X, ...: each black
+     * knight with the white knight of the same number, which is the one
+     * a black/white swap exchanges it with. A swap then maps each group
+     * onto itself (or, in groups of one, each knight's table onto its
+     * twin's), so h(x) is the same for boards that board_class() folds
+     * together. A group that split a pair would break that, and A* would
+     * drop boards it should have kept. Group members are the digits of
+     * the group's index, lowest first.
+     */
+    for (unsigned int n = 0; n < layout->pieces; ++n) {
+        unsigned int piece = (n & 1) * layout->knights_per_side + n / 2;
+        unsigned int g = n / knights, j = n % knights;
+
+        if (0 == j) {
+            patterns->table_size[g] = 1;
+            ++patterns->group_count;
+        }
+
+        patterns->group_of[piece] = g;
+        patterns->member[g][j] = piece;
+        patterns->member_count[g] = j + 1;
+
+        for (unsigned int i = 0; i < layout->squares; ++i)
+            patterns->digit[piece][i] = (layout->rank_slot[i] < 0)
+                ? 0
+                : layout->rank_slot[i] * patterns->table_size[g];
+
+        patterns->table_size[g] *= layout->slot_count;
+    }
+
+    return 0;
+}
+
+
+/* Fill one group's table by breadth-first search from the goal's pattern.
+ *  Returns nonzero if out of memory. */
+static
+int
+build_group(game_t *game,
+            unsigned int g,
+            unsigned int *frontier)
+{
+    const layout_t *layout = &game->layout;
+    patterns_t *patterns = &game->patterns;
+    unsigned int size = patterns->table_size[g];
+    unsigned int count = patterns->member_count[g];
+
+    if (NULL == patterns->distance[g]) {
+        patterns->distance[g] = malloc(size);
+        if (NULL == patterns->distance[g]) return -1;
+        STAT_ADD(SOLVER_STAT_BYTES, size);
+    }
+
+    unsigned char *distance = patterns->distance[g];
+    memset(distance, PATTERN_UNREACHABLE, size);
+
+    /* Positions with two knights on one square are never reached, so they stay unreachable. */
+    unsigned int head = 0, tail = 0;
+    unsigned int goal = pattern_index(patterns, &game->goal_board_state, g);
+    distance[goal] = 0;
+    frontier[tail++] = goal;
+
+    while (head < tail) {
+        unsigned int index = frontier[head++];
+        unsigned char square[MAX_KNIGHTS];
+        unsigned int occupied = 0;
+
+        /* Every move can be played in reverse, so searching outward from the goal will do. */
+        for (unsigned int j = 0, rest = index; j < count; ++j, rest /= layout->slot_count) {
+            square[j] = layout->slot_square[rest % layout->slot_count];
+            occupied |= 1U << square[j];
+        }
+
+        /* Entries saturate below PATTERN_UNREACHABLE, which keeps them admissible. */
+        unsigned char next_distance = MIN(distance[index] + 1, PATTERN_UNREACHABLE - 1);
+
+        for (unsigned int j = 0; j < count; ++j) {
+            unsigned int piece = patterns->member[g][j];
+            unsigned int from = square[j];
+
+            for (unsigned int to = ~occupied & layout->dest_mask[from]; to; to &= to - 1) {
+                int dest = __builtin_ctz(to);
+                unsigned int next = index - patterns->digit[piece][from] + patterns->digit[piece][dest];
+                if (PATTERN_UNREACHABLE != distance[next]) continue;
+
+                distance[next] = next_distance;
+                frontier[tail++] = next;
+            }
+        }
+    }
+
+    /* The larger of the entry and the group's per-knight distances: both are
+     * admissible and consistent for the group's moves, so their maximum is. */
+    for (unsigned int f = 0; f < tail; ++f) {
+        unsigned int index = frontier[f];
+        unsigned int knight_distances = 0;
+
+        for (unsigned int j = 0, rest = index; j < count; ++j, rest /= layout->slot_count)
+            knight_distances += game->heuristic_term[patterns->member[g][j]][layout->slot_square[rest % layout->slot_count]];
+
+        distance[index] = MAX(distance[index], MIN(knight_distances, PATTERN_UNREACHABLE - 1));
+    }
+
+    debug("\n-- Pattern database %u built: %u of %u patterns can reach the goal.\n",
+          g, tail, size);
+    return 0;
+}
+
+
+int
+pattern__build(game_t *game)
+{
+    patterns_t *patterns = &game->patterns;
+
+    if (0 == patterns->group_count) return 0;
+    if (patterns->built && patterns->goal_placement == game->goal_board_state.placement) return 0;
+
+    /* The first group's table is the largest. */
+    unsigned int *frontier = malloc(patterns->table_size[0] * sizeof(unsigned int));
+    if (NULL == frontier) return -1;
+
+    patterns->built = 0;
+    for (unsigned int g = 0; g < patterns->group_count; ++g) {
+        if (0 != build_group(game, g, frontier)) {
+            free(frontier);
+            return -1;
+        }
+    }
+
+    patterns->goal_placement = game->goal_board_state.placement;
+    patterns->built = 1;
+    free(frontier);
+    return 0;
+}
+
+
+void
+pattern__release(game_t *game)
+{
+    for (unsigned int g = 0; g < MAX_KNIGHTS; ++g) {
+        free(game->patterns.distance[g]);
+        game->patterns.distance[g] = NULL;
+    }
+}
@@ -5,20 +5,72 @@
  */
 
 #include "queue.h"
+#include "stats.h"
 
+#include <limits.h>
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
 
 
+#define MIN_OF(x,y) \
+    ((x) < (y) ? (x) : (y))
+
+/* Smallest amount of heap storage committed at once. */
+#define QUEUE_COMMIT_CHUNK  (64 * 1024)
+
+
+/* Record where an entry now lives, if the queue tracks handles. */
+static inline
+void
+note_position(queue_t *queue,
+              queue_object_t *object,
+              unsigned int bucket,
+              unsigned int slot)
+{
+    if (NULL == queue->positions || QUEUE_NO_HANDLE == object->handle) return;
+
+    queue->positions[object->handle].bucket = bucket;
+    queue->positions[object->handle].slot = slot + 1;
+}
+
+static inline
+void
+forget_position(queue_t *queue,
+                queue_object_t *object)
+{
+    if (NULL == queue->positions || QUEUE_NO_HANDLE == object->handle) return;
+
+    queue->positions[object->handle].slot = 0;
+}
+
 static inline
 void
-swap(queue_object_t *left,
-     queue_object_t *right)
+swap(queue_t *queue,
+     int left,
+     int right)
+{
+    queue_object_t temp = queue->items[left];
+    queue->items[left] = queue->items[right];
+    queue->items[right] = temp;
+
+    note_position(queue, &queue->items[left], 0, left);
+    note_position(queue, &queue->items[right], 0, right);
+}
+
+static
+void
+sift_up(queue_t *queue,
+        int i)
 {
-    queue_object_t temp = *left;
-    *left = *right;
-    *right = temp;
+    while (i != 0 &&
+        queue->items[(i - 1) / 2].F > queue->items[i].F)
+    {
+        swap(queue, i, (i - 1) / 2);
+        i = (i - 1) / 2;
+    }
 }
 
 static
@@ -39,18 +91,241 @@ min_heapify(queue_t *queue,
         smallest = right_sub;
 
     if (smallest != i) {
-        swap(&queue->items[i], &queue->items[smallest]);
+        swap(queue, i, smallest);
         min_heapify(queue, smallest);
     }
 }
 
 
+/* Binary heap: move the entries to a reservation twice as large. */
+static
+int
+heap_grow(queue_t *queue)
+{
+    if (queue->capacity > UINT_MAX / 2) return -1;
+
+    size_t reserved_bytes = queue->reserved_bytes << 1;
+    queue_object_t *items = mmap(NULL, reserved_bytes, PROT_NONE,
+                                 MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (MAP_FAILED == items) return -1;
+
+    /* Commit as much of the new mapping as was committed of the old one. */
+    if (0 != mprotect(items, queue->committed_bytes, PROT_READ | PROT_WRITE)) {
+        munmap(items, reserved_bytes);
+        return -1;
+    }
+
+    memcpy(items, queue->items, (size_t)queue->current_size * sizeof(queue_object_t));
+    munmap(queue->items, queue->reserved_bytes);
+
+    queue->items = items;
+    queue->reserved_bytes = reserved_bytes;
+    queue->capacity <<= 1;
+    return 0;
+}
+
+
+/* Binary heap: commit enough reserved pages to hold 'needed' entries. */
+static
+int
+heap_commit(queue_t *queue,
+            unsigned int needed)
+{
+    size_t bytes = (size_t)needed * sizeof(queue_object_t);
+    if (bytes <= queue->committed_bytes) return 0;
+
+    while (bytes > queue->reserved_bytes)
+        if (0 != heap_grow(queue)) return -1;
+
+    /* Grow geometrically, in whole pages, without passing the reservation. */
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    size_t target = queue->committed_bytes ? queue->committed_bytes << 1 : QUEUE_COMMIT_CHUNK;
+    while (target < bytes) target <<= 1;
+    target = (target + page - 1) & ~(page - 1);
+    if (target > queue->reserved_bytes) target = queue->reserved_bytes;
+
+    if (0 != mprotect(queue->items, target, PROT_READ | PROT_WRITE)) return -1;
+
+    STAT_ADD(SOLVER_STAT_BYTES, target - queue->committed_bytes);
+    queue->committed_bytes = target;
+    return 0;
+}
+
+
+/* Bucket queue: make sure row 'F' (and every row before it) exists. */
+static
+int
+bucket_reserve_row(queue_t *queue,
+                   unsigned int F)
+{
+    if (F < queue->rows) return 0;
+
+    unsigned int rows = queue->rows ? queue->rows : 64;
+    while (rows <= F) {
+        if (rows > UINT_MAX / 2 / QUEUE_TIE_LEVELS) return -1;
+        rows <<= 1;
+    }
+
+    size_t old_count = (size_t)queue->rows * QUEUE_TIE_LEVELS;
+    size_t new_count = (size_t)rows * QUEUE_TIE_LEVELS;
+    size_t old_words = queue->rows / 64;
+    size_t new_words = rows / 64;
+
+    queue_bucket_t *buckets = realloc(queue->buckets, new_count * sizeof(queue_bucket_t));
+    if (NULL == buckets) return -1;
+    queue->buckets = buckets;
+
+    unsigned int *row_masks = realloc(queue->row_masks, rows * sizeof(unsigned int));
+    if (NULL == row_masks) return -1;
+    queue->row_masks = row_masks;
+
+    unsigned long long *row_bits = realloc(queue->row_bits, new_words * sizeof(unsigned long long));
+    if (NULL == row_bits) return -1;
+    queue->row_bits = row_bits;
+
+    STAT_ADD(SOLVER_STAT_BYTES, (new_count - old_count) * sizeof(queue_bucket_t)
+                                + (rows - queue->rows) * sizeof(unsigned int)
+                                + (new_words - old_words) * sizeof(unsigned long long));
+    memset(&queue->buckets[old_count], 0, (new_count - old_count) * sizeof(queue_bucket_t));
+    memset(&queue->row_masks[queue->rows], 0, (rows - queue->rows) * sizeof(unsigned int));
+    memset(&queue->row_bits[old_words], 0, (new_words - old_words) * sizeof(unsigned long long));
+    queue->rows = rows;
+    return 0;
+}
+
+
+/* Bucket queue: flag a bucket of row 'F' as holding live entries. */
+static inline
+void
+bucket_mark(queue_t *queue,
+            unsigned int F,
+            unsigned int level)
+{
+    queue->row_masks[F] |= 1U << level;
+    queue->row_bits[F / 64] |= 1ULL << (F % 64);
+}
+
+
+/* Bucket queue: a bucket's last live entry is gone. Everything left in it is
+ * a superseded hole, so rewind it and clear its bits. */
+static inline
+void
+bucket_drain(queue_t *queue,
+             unsigned int index)
+{
+    unsigned int F = index / QUEUE_TIE_LEVELS;
+
+    queue->buckets[index].head = queue->buckets[index].tail = 0;
+    queue->row_masks[F] &= ~(1U << (index % QUEUE_TIE_LEVELS));
+    if (0 == queue->row_masks[F])
+        queue->row_bits[F / 64] &= ~(1ULL << (F % 64));
+}
+
+
+/* Bucket queue: turn a queued entry into a hole, as a key decrease or a
+ * removal does. */
+static inline
+void
+bucket_drop(queue_t *queue,
+            unsigned int index,
+            queue_object_t *entry)
+{
+    entry->item = NULL;
+    if (0 == --queue->buckets[index].live) bucket_drain(queue, index);
+}
+
+
+/* Bucket queue: move 'min_F' up to the first row with live entries. */
+static inline
+unsigned int
+bucket_advance(queue_t *queue)
+{
+    unsigned int word = queue->min_F / 64;
+    unsigned long long bits = queue->row_bits[word] & (~0ULL << (queue->min_F % 64));
+    while (0 == bits) bits = queue->row_bits[++word];
+
+    queue->min_F = word * 64 + __builtin_ctzll(bits);
+    return queue->min_F;
+}
+
+
+static
+int
+bucket_insert(queue_t *queue,
+              queue_object_t *object)
+{
+    unsigned int F = object->F;
+    /* H(x) is never negative, so G <= F; clamp anything odd into the row. */
+    unsigned int H = F - MIN_OF(object->G, F);
+    unsigned int level = MIN_OF(H, QUEUE_TIE_LEVELS - 1);
+
+    if (0 != bucket_reserve_row(queue, F)) return -1;
+
+    unsigned int index = F * QUEUE_TIE_LEVELS + level;
+    queue_bucket_t *bucket = &queue->buckets[index];
+    if (bucket->tail == bucket->capacity) {
+        unsigned int capacity = bucket->capacity ? bucket->capacity << 1 : 16;
+        queue_object_t *items = realloc(bucket->items, capacity * sizeof(queue_object_t));
+        if (NULL == items) return -1;
+
+        STAT_ADD(SOLVER_STAT_BYTES, (capacity - bucket->capacity) * sizeof(queue_object_t));
+        bucket->items = items;
+        bucket->capacity = capacity;
+    }
+
+    note_position(queue, object, index, bucket->tail);
+    bucket->items[bucket->tail++] = *object;
+    if (1 == ++bucket->live) bucket_mark(queue, F, level);
+
+    if (0 == queue->current_size || F < queue->min_F)
+        queue->min_F = F;
+
+    return 0;
+}
+
+
+static
+queue_object_t
+bucket_get_min(queue_t *queue)
+{
+    unsigned int F = bucket_advance(queue);
+
+    /* Break ties toward the deepest node (lowest level), oldest first. The
+     * bucket holds a live entry, so skipping superseded ones terminates. */
+    unsigned int index = F * QUEUE_TIE_LEVELS + __builtin_ctz(queue->row_masks[F]);
+    queue_bucket_t *bucket = &queue->buckets[index];
+    while (NULL == bucket->items[bucket->head].item) ++bucket->head;
+
+    queue_object_t object = bucket->items[bucket->head++];
+    if (0 == --bucket->live) bucket_drain(queue, index);
+
+    forget_position(queue, &object);
+    return object;
+}
+
+
 queue_t *
-queue__create(unsigned int capacity)
+queue__create(unsigned int capacity,
+              queue_kind_t kind)
 {
     queue_t *q = calloc(1, sizeof(queue_t));
+    if (NULL == q) return NULL;
+
+    q->kind = kind;
     q->capacity = capacity;
-    q->items = (queue_object_t *)calloc(capacity, sizeof(queue_object_t));
+
+    /* The bucket queue grows its rows on demand instead. */
+    if (QUEUE_BINARY_HEAP != kind) return q;
+
+    /* Only reserve address space here; heap_commit() backs it lazily. */
+    q->reserved_bytes = (size_t)capacity * sizeof(queue_object_t);
+    q->items = mmap(NULL, q->reserved_bytes, PROT_NONE,
+                    MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (MAP_FAILED == q->items) {
+        free(q);
+        return NULL;
+    }
+
     return q;
 }
 
@@ -60,16 +335,67 @@ queue__destroy(queue_t **queue)
 {
     if (NULL == queue || NULL == *queue) return;
 
-    free((*queue)->items);
+    queue_t *q = *queue;
+    unsigned int bucket_count = q->rows * QUEUE_TIE_LEVELS;
+    for (unsigned int i = 0; i < bucket_count; ++i)
+        free(q->buckets[i].items);
+
+    free(q->buckets);
+    free(q->row_masks);
+    free(q->row_bits);
+    free(q->positions);
+    if (NULL != q->items) munmap(q->items, q->reserved_bytes);
+    free(q);
     *queue = NULL;
 }
 
 
+void
+queue__clear(queue_t *queue)
+{
+    /* Committed heap pages and bucket storage are kept; nothing is re-zeroed.
+     * Only the handles of entries still queued need to be forgotten, and
+     * only marked buckets can hold any. */
+    for (unsigned int F = 0; F < queue->rows; ++F) {
+        for (unsigned int mask = queue->row_masks[F]; 0 != mask; mask &= mask - 1) {
+            queue_bucket_t *bucket = &queue->buckets[F * QUEUE_TIE_LEVELS + __builtin_ctz(mask)];
+            for (unsigned int j = bucket->head; j < bucket->tail; ++j)
+                forget_position(queue, &bucket->items[j]);
+
+            bucket->head = bucket->tail = bucket->live = 0;
+        }
+
+        queue->row_masks[F] = 0;
+    }
+
+    if (queue->rows)
+        memset(queue->row_bits, 0, queue->rows / 64 * sizeof(unsigned long long));
+
+    if (QUEUE_BINARY_HEAP == queue->kind)
+        for (unsigned int i = 0; i < queue->current_size; ++i)
+            forget_position(queue, &queue->items[i]);
+
+    queue->min_F = 0;
+    queue->current_size = 0;
+}
+
+
 int
 queue__contains(queue_t* queue,
                 item_t item,
                 unsigned long long length)
 {
+    if (QUEUE_BUCKET == queue->kind) {
+        unsigned int bucket_count = queue->rows * QUEUE_TIE_LEVELS;
+        for (unsigned int b = 0; b < bucket_count; b++)
+            for (unsigned int i = queue->buckets[b].head; i < queue->buckets[b].tail; i++)
+                if (NULL != queue->buckets[b].items[i].item &&
+                        0 == memcmp(queue->buckets[b].items[i].item, item, length))
+                    return 1;
+
+        return 0;
+    }
+
     for (int i = 0; i < queue->current_size; i++)
         if (0 == memcmp(queue->items[i].item, item, length))
             return 1;
@@ -78,32 +404,134 @@ queue__contains(queue_t* queue,
 }
 
 
-void
+int
+queue__index(queue_t *queue,
+             unsigned int handles)
+{
+    if (handles <= queue->handles) return 0;
+
+    queue_position_t *positions = realloc(queue->positions, handles * sizeof(queue_position_t));
+    if (NULL == positions) return -1;
+
+    STAT_ADD(SOLVER_STAT_BYTES, (handles - queue->handles) * sizeof(queue_position_t));
+    memset(&positions[queue->handles], 0, (handles - queue->handles) * sizeof(queue_position_t));
+    queue->positions = positions;
+    queue->handles = handles;
+    return 0;
+}
+
+
+int
 queue__insert(queue_t *queue,
               item_t item,
               unsigned int F,
               unsigned int G,
               unsigned int H)
 {
-    if (queue->current_size == queue->capacity) {
-        fprintf(stderr, "The queue exceeded its limit. Consider increasing it.\n");
-        exit(1);
+    return queue__insert_indexed(queue, QUEUE_NO_HANDLE, item, F, G, H);
+}
+
+
+int
+queue__insert_indexed(queue_t *queue,
+                      unsigned int handle,
+                      item_t item,
+                      unsigned int F,
+                      unsigned int G,
+                      unsigned int H)
+{
+    queue_object_t object = { .item = item, .F = F, .G = G, .H = H, .handle = handle };
+
+    if (QUEUE_BUCKET == queue->kind) {
+        if (0 != bucket_insert(queue, &object)) return -1;
+        ++queue->current_size;
+        return 0;
     }
 
-    queue->items[queue->current_size].item = item;
-    queue->items[queue->current_size].F = F;
-    queue->items[queue->current_size].G = G;
-    queue->items[queue->current_size].H = H;
+    if (0 != heap_commit(queue, queue->current_size + 1)) return -1;
+
+    queue->items[queue->current_size] = object;
+    note_position(queue, &object, 0, queue->current_size);
 
     ++queue->current_size;
+    sift_up(queue, queue->current_size - 1);
 
-    int i = queue->current_size - 1;
-    while (i != 0 &&
-        queue->items[(i - 1) / 2].F > queue->items[i].F)
-    {
-        swap(&queue->items[i], &queue->items[(i - 1) / 2]);
-        i = (i - 1) / 2;
+    return 0;
+}
+
+
+queue_object_t *
+queue__find(queue_t *queue,
+            unsigned int handle)
+{
+    if (handle >= queue->handles || 0 == queue->positions[handle].slot) return NULL;
+
+    queue_position_t *where = &queue->positions[handle];
+    if (QUEUE_BUCKET == queue->kind)
+        return &queue->buckets[where->bucket].items[where->slot - 1];
+
+    return &queue->items[where->slot - 1];
+}
+
+
+int
+queue__decrease_key(queue_t *queue,
+                    unsigned int handle,
+                    item_t item,
+                    unsigned int F,
+                    unsigned int G,
+                    unsigned int H)
+{
+    queue_object_t *entry = queue__find(queue, handle);
+    if (NULL == entry) return -1;
+
+    if (QUEUE_BUCKET == queue->kind) {
+        /* Leave a hole where the old entry was and file the new one under its new key. */
+        bucket_drop(queue, queue->positions[handle].bucket, entry);
+
+        queue_object_t object = { .item = item, .F = F, .G = G, .H = H, .handle = handle };
+        if (0 != bucket_insert(queue, &object)) return -1;
+        return 0;
     }
+
+    entry->item = item;
+    entry->F = F;
+    entry->G = G;
+    entry->H = H;
+    sift_up(queue, queue->positions[handle].slot - 1);
+
+    return 0;
+}
+
+
+/* Take the entry for a handle out of the queue. Returns nonzero if it has none. */
+int
+queue__remove(queue_t *queue,
+              unsigned int handle)
+{
+    queue_object_t *entry = queue__find(queue, handle);
+    if (NULL == entry) return -1;
+
+    forget_position(queue, entry);
+    --queue->current_size;
+
+    if (QUEUE_BUCKET == queue->kind) {
+        /* Leave a hole, as a key decrease does. */
+        bucket_drop(queue, queue->positions[handle].bucket, entry);
+        return 0;
+    }
+
+    /* Fill the gap with the last entry, which may belong above or below it.
+     * Whichever entry sift_up() leaves at 'i' is already in order below. */
+    unsigned int i = entry - queue->items;
+    if (i == queue->current_size) return 0;
+
+    queue->items[i] = queue->items[queue->current_size];
+    note_position(queue, &queue->items[i], 0, i);
+    sift_up(queue, i);
+    min_heapify(queue, i);
+
+    return 0;
 }
 
 
@@ -118,17 +546,39 @@ queue__get_min(queue_t *queue)
     };
     if (queue->current_size <= 0) return q;
 
+    if (QUEUE_BUCKET == queue->kind) {
+        q = bucket_get_min(queue);
+        --queue->current_size;
+        return q;
+    }
+
     if (queue->current_size == 1) {
         --queue->current_size;
+        forget_position(queue, &queue->items[0]);
         return queue->items[0];
     }
 
     queue_object_t root = queue->items[0];
+    forget_position(queue, &root);
 
     queue->items[0] = queue->items[queue->current_size - 1];
+    note_position(queue, &queue->items[0], 0, 0);
     --queue->current_size;
 
     min_heapify(queue, 0);
 
     return root;
 }
+
+
+/* F(x) of the entry queue__get_min would return next, left in place. */
+unsigned int
+queue__min_F(queue_t *queue)
+{
+    if (queue->current_size <= 0) return QUEUE_NO_F;
+
+    if (QUEUE_BUCKET == queue->kind)
+        return bucket_advance(queue);
+
+    return queue->items[0].F;
+}
@@ -7,6 +7,10 @@
 #ifndef FOURKNIGHTS_QUEUE_H
 #define FOURKNIGHTS_QUEUE_H
 
+#include "fourknights.h"
+
+#include <stddef.h>
+
 
 typedef void * item_t;
 typedef struct
@@ -15,19 +19,81 @@ typedef struct
     unsigned int F;   /* F(x) = G(x) + H(x) */
     unsigned int G;   /* G(x) */
     unsigned int H;   /* H(x) */
+    unsigned int handle;   /* Caller's state index, or QUEUE_NO_HANDLE. */
 } queue_object_t;
 
+#define QUEUE_NO_HANDLE  (~0U)
+
+/* What queue__min_F reports for an empty queue. */
+#define QUEUE_NO_F       (~0U)
+
+/* Where the entry for a handle currently sits. A 'slot' of 0 means absent. */
+typedef struct
+{
+    unsigned int bucket;
+    unsigned int slot;
+} queue_position_t;
+
+/*
+ * Tie levels per row of the bucket queue. Level F - G (capped at the last
+ * level) orders the entries of one row, so deeper nodes come out first for
+ * every H(x) up to the cap and the rest share the last level.
+ */
+#define QUEUE_TIE_LEVELS  32
+
+/* A single FIFO of the bucket queue, holding entries of one row and level. */
 typedef struct
 {
     queue_object_t *items;
+    unsigned int head;
+    unsigned int tail;
     unsigned int capacity;
+    unsigned int live;        /* Entries not yet superseded or removed. */
+} queue_bucket_t;
+
+typedef struct
+{
+    queue_kind_t kind;
+    queue_object_t *items;
+    unsigned int capacity;       /* Entries the heap's reservation holds. */
     unsigned int current_size;
+
+    /*
+     * Binary heap only. Address space for 'capacity' entries is reserved
+     * up front but pages are only committed as the heap grows into them,
+     * and they stay committed when the queue is cleared for reuse. A heap
+     * that fills its reservation moves to one twice as large.
+     */
+    size_t reserved_bytes;
+    size_t committed_bytes;
+
+    /*
+     * Bucket queue only. Each row F holds QUEUE_TIE_LEVELS buckets, so
+     * entry (F, level) lives at F * QUEUE_TIE_LEVELS + level. A row's mask
+     * has a bit per level with live entries, and 'row_bits' has a bit per
+     * row with a non-zero mask, so the minimum is found without scanning
+     * empty buckets. 'min_F' moves down on insert and up over empty rows.
+     */
+    queue_bucket_t     *buckets;
+    unsigned int       *row_masks;
+    unsigned long long *row_bits;
+    unsigned int        rows;
+    unsigned int        min_F;
+
+    /*
+     * Optional handle index (see queue__index), mapping a state index to
+     * the position of its entry. Superseded bucket entries are left in
+     * place with a NULL item and skipped when popped.
+     */
+    queue_position_t *positions;
+    unsigned int      handles;
 } queue_t;
 
 
 queue_t *
 queue__create(
-    unsigned int capacity
+    unsigned int capacity,
+    queue_kind_t kind
 );
 
 void
@@ -35,6 +101,17 @@ queue__destroy(
     queue_t **queue
 );
 
+void
+queue__clear(
+    queue_t *queue
+);
+
+int
+queue__index(
+    queue_t *queue,
+    unsigned int handles
+);
+
 int
 queue__contains(
     queue_t *queue,
@@ -42,7 +119,7 @@ queue__contains(
     unsigned long long length
 );
 
-void
+int
 queue__insert(
     queue_t *queue,
     item_t item,
@@ -51,10 +128,47 @@ queue__insert(
     unsigned int H
 );
 
+int
+queue__insert_indexed(
+    queue_t *queue,
+    unsigned int handle,
+    item_t item,
+    unsigned int F,
+    unsigned int G,
+    unsigned int H
+);
+
+queue_object_t *
+queue__find(
+    queue_t *queue,
+    unsigned int handle
+);
+
+int
+queue__decrease_key(
+    queue_t *queue,
+    unsigned int handle,
+    item_t item,
+    unsigned int F,
+    unsigned int G,
+    unsigned int H
+);
+
+int
+queue__remove(
+    queue_t *queue,
+    unsigned int handle
+);
+
 queue_object_t
 queue__get_min(
     queue_t *queue
 );
 
+unsigned int
+queue__min_F(
+    queue_t *queue
+);
+
 
 #endif   /* FOURKNIGHTS_QUEUE_H */
@@ -0,0 +1,523 @@
+/*
+ * sma.c
+ *
+ *  Memory-bounded A* after SMA*: best-first search in a pool of nodes
+ *  that grows as needed up to the solver's node budget.
+ *
+ *  The search tree lives entirely in the pool. Once it is full, making
+ *  room for a successor evicts the worst leaf: the one with the highest
+ *  f(x), shallowest first. Its f(x) is not lost but backed up into its
+ *  parent as the least f(x) among the parent's forgotten children, so
+ *  the parent returns to the open list under that key and regenerates
+ *  them if they ever become the most promising boards again. A successor
+ *  worse than every leaf is forgotten the same way instead of being kept.
+ *
+ *  Each node's f(x) is backed up from its children as they are expanded
+ *  or forgotten, and never drops below its parent's (pathmax), so f(x)
+ *  stays a lower bound on any route through the node. A board as deep as
+ *  the pool allows that isn't the goal has no room for a route on from
+ *  it, so it counts as at least the budget long. The first goal selected
+ *  is therefore optimal whenever the optimal route fits in the pool, and
+ *  once every open board is at least the budget long, none can fit.
+ *
+ *  A successor is dropped if its board is already in the pool as cheaply,
+ *  which covers any board on its own route. A hash map leads to each
+ *  board's copies in the pool, cheapest first.
+ */
+
+#include "game.h"
+#include "hashmap.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+
+#define SMA_INFINITY    DISTANCE_UNKNOWN
+#define SMA_NO_NODE     ARENA_NO_NODE
+
+/* Slots the pool starts with before doubling towards the budget. */
+#define SMA_MIN_CAPACITY  1024
+
+/* Most successors one board can have: every knight, with at most eight moves. */
+#define SMA_MAX_MOVES   (2 * MAX_KNIGHTS * 8)
+
+
+typedef struct
+{
+    board_t        board;          /* parent_index links nodes of the pool, not the arena. */
+    unsigned int   f;              /* Backed-up f(x). */
+    unsigned int   forgotten;      /* Least f(x) among evicted children, or SMA_INFINITY. */
+    unsigned int   first_child;
+    unsigned int   next_sibling;   /* Also links the free slots. */
+    unsigned int   next_copy;      /* Next dearer node of the same board. */
+    unsigned int   children;       /* Children in the pool. */
+} sma_node_t;
+
+typedef struct
+{
+    sma_node_t    *pool;
+    unsigned int   budget;
+    unsigned int   capacity;       /* Slots allocated so far, up to the budget. */
+    unsigned int   used;           /* Slots ever handed out; those past it are untouched. */
+    unsigned int   free_list;
+    queue_t       *open;           /* Lowest f(x) first, deepest first among ties. */
+    queue_t       *leaves;         /* Highest f(x) first, shallowest first among ties. */
+    hashmap_t     *copies;         /* Board rank -> its cheapest copy, or SMA_NO_NODE. Free slots have no node_index. */
+    unsigned int   too_long;       /* f(x) of routes that can't fit: the budget, within what keys hold. */
+    unsigned int   expanding;      /* The node getting children, which mustn't be evicted for them. */
+    int            cut;            /* A route was given up for lack of room. */
+} sma_t;
+
+/* One successor waiting to be placed in the pool. */
+typedef struct
+{
+    board_t        board;
+    unsigned int   f;
+} sma_candidate_t;
+
+
+/* Queue keys pack f(x) and depth into one word, so ties break inside the heap. */
+static inline
+unsigned int
+open_key(unsigned int f,
+         unsigned int depth)
+{
+    return (f << 16) | (0xFFFF - MIN(depth, 0xFFFF));
+}
+
+static inline
+unsigned int
+leaf_key(unsigned int f,
+         unsigned int depth)
+{
+    return ((0xFFFF - f) << 16) | MIN(depth, 0xFFFF);
+}
+
+static inline
+unsigned int
+leaf_key_f(unsigned int key)
+{
+    return 0xFFFF - (key >> 16);
+}
+
+
+/* The pool's cheapest copy of a board, or SMA_NO_NODE. */
+static inline
+unsigned int
+find_copy(sma_t *sma,
+          board_t *board)
+{
+    return hashmap__get(sma->copies, get_state_code(board), SMA_NO_NODE);
+}
+
+
+/* Link a node in among the copies of its board, in order of g(x). A new
+ *  node is cheaper than all of them, or seen_before would have dropped it,
+ *  so it goes first. Returns nonzero if out of memory. */
+static
+int
+note_copy(sma_t *sma,
+          unsigned int slot)
+{
+    board_t *board = &sma->pool[slot].board;
+    unsigned int *link;
+
+    int added = hashmap__claim(sma->copies, get_state_code(board), &link);
+    if (added < 0) return -1;
+    if (added) *link = SMA_NO_NODE;
+
+    while (SMA_NO_NODE != *link && sma->pool[*link].board.moves_from_start < board->moves_from_start)
+        link = &sma->pool[*link].next_copy;
+
+    sma->pool[slot].next_copy = *link;
+    *link = slot;
+    return 0;
+}
+
+
+/*
+ * Whether a successor is no better than a board already in the pool. Only
+ * the cheapest copy needs checking, and every node on the successor's own
+ * route is in the pool. Either way, the copy covers every route through the
+ * successor, in the pool or in the forgotten f(x) of an ancestor.
+ */
+static inline
+int
+seen_before(sma_t *sma,
+            board_t *successor)
+{
+    unsigned int known = find_copy(sma, successor);
+    return SMA_NO_NODE != known && sma->pool[known].board.moves_from_start <= successor->moves_from_start;
+}
+
+
+/* File a node under its current keys: in the open list while it is a leaf
+ *  or has forgotten children, and among the leaves unless it is the root.
+ *  Returns nonzero if out of room. */
+static
+int
+requeue(sma_t *sma,
+        unsigned int slot)
+{
+    sma_node_t *node = &sma->pool[slot];
+    unsigned int depth = node->board.moves_from_start;
+
+    queue__remove(sma->open, slot);
+    queue__remove(sma->leaves, slot);
+
+    unsigned int key = (0 == node->children) ? node->f : node->forgotten;
+    /* Entries are found by slot alone, as the pool moves when it grows. */
+    if (SMA_INFINITY != key) {
+        if (0 != queue__insert_indexed(sma->open, slot, NULL, open_key(key, depth), depth, 0)) return -1;
+        STAT_ADD(SOLVER_STAT_PUSHES, 1);
+        STAT_PEAK(SOLVER_STAT_OPEN_PEAK, sma->open->current_size);
+    }
+
+    if (0 == node->children && 0 != slot && slot != sma->expanding)
+        return queue__insert_indexed(sma->leaves, slot, NULL, leaf_key(node->f, depth), depth, 0);
+
+    return 0;
+}
+
+
+/* Recompute f(x) from a node's children, and on up its route for as long as it changes.
+ *  Returns nonzero if out of room. */
+static
+int
+back_up(sma_t *sma,
+        unsigned int slot)
+{
+    while (SMA_NO_NODE != slot) {
+        sma_node_t *node = &sma->pool[slot];
+        unsigned int f = node->forgotten;
+
+        for (unsigned int c = node->first_child; SMA_NO_NODE != c; c = sma->pool[c].next_sibling)
+            f = MIN(f, sma->pool[c].f);
+
+        f = MAX(f, node->f);
+        if (f == node->f) return 0;
+
+        node->f = f;
+        if (0 != requeue(sma, slot)) return -1;
+        slot = node->board.parent_index;
+    }
+
+    return 0;
+}
+
+
+/* Keep the copies map to about the pool's size: once it holds twice as
+ *  many boards, most of them evicted, rebuild it from the pool. */
+static
+int
+forget_copies(sma_t *sma)
+{
+    if (sma->copies->count < 2 * sma->budget) return 0;
+
+    hashmap__clear(sma->copies);
+    for (unsigned int slot = 0; slot < sma->used; ++slot)
+        if (slot == sma->pool[slot].board.node_index && 0 != note_copy(sma, slot)) return -1;
+
+    return 0;
+}
+
+
+/* Drop a leaf, leaving its f(x) with its parent. Returns nonzero if out of room. */
+static
+int
+evict(sma_t *sma,
+      unsigned int slot)
+{
+    sma_node_t *leaf = &sma->pool[slot];
+    unsigned int parent_slot = leaf->board.parent_index;
+    sma_node_t *parent = &sma->pool[parent_slot];
+
+    queue__remove(sma->open, slot);
+    queue__remove(sma->leaves, slot);
+
+    unsigned int *link = &parent->first_child;
+    while (*link != slot) link = &sma->pool[*link].next_sibling;
+    *link = leaf->next_sibling;
+    --parent->children;
+    parent->forgotten = MIN(parent->forgotten, leaf->f);
+
+    /* The board is already in the map, so claiming it can't fail. */
+    hashmap__claim(sma->copies, get_state_code(&leaf->board), &link);
+    while (*link != slot) link = &sma->pool[*link].next_copy;
+    *link = leaf->next_copy;
+
+    leaf->board.node_index = SMA_NO_NODE;
+    leaf->next_sibling = sma->free_list;
+    sma->free_list = slot;
+    if (0 != forget_copies(sma)) return -1;
+
+    /* The parent's f(x) stands, as the forgotten child's is still counted. */
+    return requeue(sma, parent_slot);
+}
+
+
+/* Double the pool and the heaps' slot indexes, up to the budget. Returns nonzero if out of memory. */
+static
+int
+grow_pool(sma_t *sma)
+{
+    unsigned int capacity = sma->budget;
+    if (sma->capacity < sma->budget / 2)
+        capacity = MIN(MAX(2 * sma->capacity, SMA_MIN_CAPACITY), sma->budget);
+
+    sma_node_t *pool = realloc(sma->pool, (size_t)capacity * sizeof(sma_node_t));
+    if (NULL == pool) return -1;
+
+    STAT_ADD(SOLVER_STAT_BYTES, (size_t)(capacity - sma->capacity) * sizeof(sma_node_t));
+    sma->pool = pool;
+    sma->capacity = capacity;
+
+    if (0 != queue__index(sma->open, capacity) || 0 != queue__index(sma->leaves, capacity)) return -1;
+    return 0;
+}
+
+
+/* A free slot in '*slot', growing the pool while it is under budget and then
+ *  evicting the worst leaf if it is worse than 'f', or whatever its f(x) when
+ *  'force' is set. '*slot' is SMA_NO_NODE if there is no room. Returns
+ *  nonzero if out of memory. */
+static
+int
+take_slot(sma_t *sma,
+          unsigned int f,
+          int force,
+          unsigned int *slot)
+{
+    *slot = SMA_NO_NODE;
+
+    if (SMA_NO_NODE == sma->free_list) {
+        if (sma->used < sma->budget) {
+            if (sma->used == sma->capacity && 0 != grow_pool(sma)) return -1;
+            *slot = sma->used++;
+            return 0;
+        }
+
+        unsigned int worst = queue__min_F(sma->leaves);
+        if (QUEUE_NO_F == worst || (!force && leaf_key_f(worst) <= f)) return 0;
+
+        if (0 != evict(sma, queue__get_min(sma->leaves).handle)) return -1;
+    }
+
+    *slot = sma->free_list;
+    sma->free_list = sma->pool[*slot].next_sibling;
+    return 0;
+}
+
+
+/* Place the successors of a node that aren't in the pool, best first, while
+ *  room can be made for them; the rest are forgotten. Returns nonzero if out of room. */
+static
+int
+expand_node(game_t *game,
+            sma_t *sma,
+            unsigned int slot)
+{
+    const layout_t *layout = &game->layout;
+    sma_node_t *node = &sma->pool[slot];
+    sma_candidate_t candidates[SMA_MAX_MOVES];
+    unsigned int count = 0;
+
+    /* Regenerated children inherit what was learned before they were forgotten. */
+    unsigned int floor_f = (SMA_INFINITY != node->forgotten) ? MAX(node->forgotten, node->f) : node->f;
+    board_t *board = &node->board;
+    unsigned int empty = ~board->occupied;
+
+    for (unsigned int from = board->occupied; from; from &= from - 1) {
+        int i = __builtin_ctz(from);
+        int piece = piece_at(board, i);
+
+        for (unsigned int to = empty & layout->dest_mask[i]; to; to &= to - 1) {
+            int dest = __builtin_ctz(to);
+            sma_candidate_t *candidate = &candidates[count];
+
+            candidate->board = *board;
+            candidate->board.square[piece] = dest;
+            candidate->board.hash ^= layout->zobrist_key[i][piece] ^ layout->zobrist_key[dest][piece];
+            candidate->board.rank = rank_after_move(layout, board, piece, i, dest);
+            candidate->board.moves_from_start = board->moves_from_start + 1;
+            STAT_ADD(SOLVER_STAT_SUCCESSORS, 1);
+
+            if (seen_before(sma, &candidate->board)) {
+                STAT_ADD(SOLVER_STAT_DUPLICATES, 1);
+                continue;
+            }
+
+            candidate->board.occupied ^= (1U << i) | (1U << dest);
+            candidate->board.h_x = heuristic_after_move(game, board, piece, i, dest);
+            candidate->board.parent_index = slot;
+            candidate->f = MAX(floor_f, candidate->board.moves_from_start + candidate->board.h_x);
+
+            /* With no room below it, any route on from it is longer than fits. */
+            if (candidate->board.moves_from_start + 1 >= sma->budget
+                    && candidate->board.placement != game->goal_board_state.placement)
+                candidate->f = MAX(candidate->f, sma->too_long);
+
+            /* Keep them sorted by f(x); there are only a handful. */
+            for (unsigned int c = count++; c > 0 && candidates[c - 1].f > candidates[c].f; --c) {
+                sma_candidate_t swap = candidates[c];
+                candidates[c] = candidates[c - 1];
+                candidates[c - 1] = swap;
+            }
+        }
+    }
+
+    node->forgotten = SMA_INFINITY;
+
+    /* Out of the leaves while it gets children, so it is never evicted for them. */
+    sma->expanding = slot;
+    queue__remove(sma->leaves, slot);
+
+    /* The best successor makes room for itself whatever it costs, so every expansion gets somewhere. */
+    unsigned int c = 0;
+    for (; c < count; ++c) {
+        unsigned int child_slot;
+        if (0 != take_slot(sma, candidates[c].f, 0 == node->children, &child_slot)) return -1;
+        if (SMA_NO_NODE == child_slot) break;
+
+        /* Growing the pool may have moved it. */
+        node = &sma->pool[slot];
+        sma_node_t *child = &sma->pool[child_slot];
+        child->board = candidates[c].board;
+        child->board.node_index = child_slot;
+        child->f = candidates[c].f;
+        child->forgotten = SMA_INFINITY;
+        child->first_child = SMA_NO_NODE;
+        child->children = 0;
+
+        child->next_sibling = node->first_child;
+        node->first_child = child_slot;
+        ++node->children;
+
+        if (0 != note_copy(sma, child_slot) || 0 != requeue(sma, child_slot)) return -1;
+    }
+
+    sma->expanding = SMA_NO_NODE;
+
+    if (c < count) {
+        /* With no child at all, every other node is on this one's route (the
+         * budget check should already have stopped short of that). */
+        if (0 == node->children)
+            sma->cut = 1;
+        else
+            node->forgotten = MIN(node->forgotten, candidates[c].f);
+    }
+
+    /* A board left with no children, a dead end or cut, backs up as SMA_INFINITY. */
+    if (0 != requeue(sma, slot)) return -1;
+    return back_up(sma, slot);
+}
+
+
+/* Replay the route from the pool's root to a node in the game's arena, as the other searches leave it. */
+static
+solver_status_t
+replay_route(game_t *game,
+             sma_t *sma,
+             unsigned int slot)
+{
+    unsigned int length = sma->pool[slot].board.moves_from_start;
+    solver_move_t *path = malloc((length ? length : 1) * sizeof(solver_move_t));
+    if (NULL == path) return SOLVER_OUT_OF_MEMORY;
+
+    for (unsigned int m = length; m > 0; --m) {
+        board_t *board = &sma->pool[slot].board;
+        board_t *parent = &sma->pool[board->parent_index].board;
+
+        int piece = 0;
+        while (board->square[piece] == parent->square[piece]) ++piece;
+
+        path[m - 1].knight = STATE_OF(piece);
+        path[m - 1].from = parent->square[piece];
+        path[m - 1].to = board->square[piece];
+        slot = board->parent_index;
+    }
+
+    for (unsigned int m = 0; m < length; ++m) {
+        board_t *next_state = spawn_successor(game, game->current_board_state,
+                                              PIECE_OF(path[m].knight),
+                                              path[m].from,
+                                              path[m].to);
+        if (NULL == next_state) {
+            free(path);
+            return SOLVER_OUT_OF_MEMORY;
+        }
+
+        game->current_board_state = next_state;
+    }
+
+    free(path);
+    return SOLVER_OK;
+}
+
+
+/* SMA*: Best-first search within the node budget, evicting the worst leaves to make room. */
+solver_status_t
+sma__solve(game_t *game)
+{
+    debug("\n-- Running memory-bounded A* Search on %u nodes...\n", game->node_budget);
+
+    /* A tree search would take a very long time to exhaust an unreachable goal. */
+    if (!goal_reachable(game)) return SOLVER_NO_SOLUTION;
+
+    solver_status_t status = SOLVER_OUT_OF_MEMORY;
+    sma_t sma = {
+        .budget = game->node_budget,
+        .used = 1,
+        .free_list = SMA_NO_NODE,
+        .expanding = SMA_NO_NODE,
+        .too_long = MIN(game->node_budget, SMA_INFINITY - 1),
+        .open = queue__create(game->node_budget, QUEUE_BINARY_HEAP),
+        .leaves = queue__create(game->node_budget, QUEUE_BINARY_HEAP),
+        .copies = hashmap__create(1 << 10),
+    };
+
+    if (NULL == sma.open || NULL == sma.leaves || NULL == sma.copies || 0 != grow_pool(&sma))
+        goto done;
+
+    /* Slot 0 is the root. */
+    sma_node_t *root = &sma.pool[0];
+    root->board = *game->current_board_state;
+    root->board.node_index = 0;
+    root->board.parent_index = SMA_NO_NODE;
+    root->f = root->board.moves_from_start + root->board.h_x;
+    root->forgotten = SMA_INFINITY;
+    root->first_child = SMA_NO_NODE;
+    root->next_sibling = SMA_NO_NODE;
+    root->children = 0;
+
+    if (0 != note_copy(&sma, 0) || 0 != requeue(&sma, 0)) goto done;
+
+    unsigned int slot;
+    for (;;) {
+        if (0 == sma.open->current_size) {
+            status = sma.cut ? SOLVER_OUT_OF_MEMORY : SOLVER_NO_SOLUTION;
+            goto done;
+        }
+
+        /* Every route left is too long to fit in the pool. */
+        if ((queue__min_F(sma.open) >> 16) >= sma.too_long) goto done;
+
+        slot = queue__get_min(sma.open).handle;
+        STAT_ADD(SOLVER_STAT_POPS, 1);
+
+        if (sma.pool[slot].board.placement == game->goal_board_state.placement) break;
+
+        ++game->expansions;
+        if (0 != expand_node(game, &sma, slot)) goto done;
+    }
+
+    status = replay_route(game, &sma, slot);
+
+done:
+    game->other_nodes = sma.used;
+    queue__destroy(&sma.open);
+    queue__destroy(&sma.leaves);
+    hashmap__destroy(&sma.copies);
+    free(sma.pool);
+    return status;
+}
@@ -0,0 +1,783 @@
+/*
+ * solver.c
+ *
+ *  The search engines, and the library interface which runs them.
+ */
+
+#include "game.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+/* Retrograde: Label every state with its exact distance to the goal.
+ *  Returns nonzero if the table could not be allocated, or would be too
+ *  large to index by rank (see DENSE_STATE_LIMIT). */
+static
+int
+retro__build_table(game_t *game,
+                   board_t *goal)
+{
+    /*
+     * One breadth-first search backward from the goal covers the whole
+     * knight graph. Every knight move can be played in reverse, so the
+     * backward graph is the forward one and the ordinary move generation
+     * applies as-is.
+     */
+    unsigned long long state_count = game->layout.state_count;
+    if (state_count > DENSE_STATE_LIMIT) return -1;
+
+    unsigned int *frontier = malloc(state_count * sizeof(unsigned int));
+    if (NULL == frontier) return -1;
+
+    /* The game keeps the table from here on, even if it moved. */
+    unsigned short *distances = realloc(game->goal_distances, state_count * sizeof(unsigned short));
+    if (NULL == distances) {
+        free(frontier);
+        return -1;
+    }
+    game->goal_distances = distances;
+
+    STAT_ADD(SOLVER_STAT_BYTES, state_count * sizeof(unsigned short));
+    game->goal_distances_rank = goal->rank;
+    memset(distances, 0xFF, state_count * sizeof(unsigned short));
+
+    unsigned int head = 0, tail = 0;
+    distances[goal->rank] = 0;
+    frontier[tail++] = goal->rank;
+
+    while (head < tail) {
+        unsigned int rank = frontier[head++];
+
+        /* With the state graph, the successors are a run of ranks to scan. */
+        if (NULL != game->graph) {
+            const graph_t *graph = game->graph;
+
+            for (unsigned int e = graph->offsets[rank]; e < graph->offsets[rank + 1]; ++e) {
+                unsigned int next_rank = graph->targets[e];
+                if (DISTANCE_UNKNOWN != distances[next_rank]) continue;
+
+                distances[next_rank] = distances[rank] + 1;
+                frontier[tail++] = next_rank;
+            }
+            continue;
+        }
+
+        board_t board;
+        unrank_board(&game->layout, &board, rank);
+
+        unsigned int empty = ~board.occupied;
+        for (unsigned int from = board.occupied; from; from &= from - 1) {
+            int i = __builtin_ctz(from);
+            int piece = piece_at(&board, i);
+
+            for (unsigned int to = empty & game->layout.dest_mask[i]; to; to &= to - 1) {
+                unsigned int next_rank = (unsigned int)rank_after_move(&game->layout, &board, piece, i, __builtin_ctz(to));
+                if (DISTANCE_UNKNOWN != distances[next_rank]) continue;
+
+                distances[next_rank] = distances[board.rank] + 1;
+                frontier[tail++] = next_rank;
+            }
+        }
+    }
+
+    debug("\n-- Retrograde table built: %u of %llu states can reach the goal.\n",
+          tail, state_count);
+    free(frontier);
+    return 0;
+}
+
+
+/* Retrograde: A board's distance to the goal, read through the symmetry taking the goal to the table's. */
+static inline
+unsigned short
+retro__distance(game_t *game,
+                board_t *board,
+                unsigned int symmetry)
+{
+    if (0 == symmetry) return game->goal_distances[board->rank];
+
+    board_t image;
+    transform_board(&game->layout, &image, board, symmetry);
+    return game->goal_distances[image.rank];
+}
+
+
+/* Retrograde: Make sure the distance table is the one for the game's goal.
+ *  Sets '*symmetry' to the symmetry taking the goal to the table's goal.
+ *  Returns nonzero if the table could not be built. */
+static
+int
+retro__prepare(game_t *game,
+               unsigned int *symmetry)
+{
+    /*
+     * The table only depends on the goal, and symmetric goals share one:
+     * it is built for the goal's canonical form, and every board is
+     * mapped the same way before looking it up.
+     */
+    board_t table_goal;
+    *symmetry = canonical_board(&game->layout, &table_goal, &game->goal_board_state, ~0U);
+
+    if (NULL != game->goal_distances && game->goal_distances_rank == table_goal.rank) return 0;
+    return retro__build_table(game, &table_goal);
+}
+
+
+/* Retrograde: Walk straight down the distance table from the start to the goal. */
+static
+solver_status_t
+retro__solve(game_t *game)
+{
+    unsigned int symmetry;
+    if (0 != retro__prepare(game, &symmetry)) return SOLVER_OUT_OF_MEMORY;
+
+    if (DISTANCE_UNKNOWN == retro__distance(game, game->current_board_state, symmetry))
+        return SOLVER_NO_SOLUTION;
+
+    /* Each step takes the first move leading to a state one closer to the goal. */
+    while (0 != check_game(game)) {
+        ++game->expansions;
+
+        board_t *current_state = game->current_board_state;
+        unsigned short next_distance = retro__distance(game, current_state, symmetry) - 1;
+        unsigned int empty = ~current_state->occupied;
+        board_t *next_state = NULL;
+
+        for (unsigned int from = current_state->occupied; from && !next_state; from &= from - 1) {
+            int i = __builtin_ctz(from);
+            int piece = piece_at(current_state, i);
+
+            for (unsigned int to = empty & game->layout.dest_mask[i]; to; to &= to - 1) {
+                int dest = __builtin_ctz(to);
+
+                board_t next = *current_state;
+                next.square[piece] = dest;
+                next.rank = rank_after_move(&game->layout, current_state, piece, i, dest);
+                if (next_distance != retro__distance(game, &next, symmetry)) continue;
+
+                next_state = spawn_successor_in(&game->layout, game->nodes, current_state, piece, i, dest);
+                if (NULL == next_state) return SOLVER_OUT_OF_MEMORY;
+                break;
+            }
+        }
+
+        game->current_board_state = next_state;
+        debug("\n === Descended to Distance %u ===\n", next_distance);
+        print_board(&game->layout, game->current_board_state);
+    }
+
+    return SOLVER_OK;
+}
+
+
+static
+int
+ida__search(game_t *game,
+            board_t *board,
+            unsigned int bound,
+            unsigned int *next_bound,
+            solver_move_t *path);
+
+
+/* IDA*: Play one move on the board, search below it, and take it back.
+ *  Returns 1 once the goal is reached. */
+static inline
+int
+ida__try_move(game_t *game,
+              board_t *board,
+              unsigned int bound,
+              unsigned int *next_bound,
+              solver_move_t *path,
+              int piece,
+              int from,
+              int to,
+              unsigned long long next_rank)
+{
+    unsigned int g_x = board->moves_from_start;
+
+    /* Moving the last knight straight back only returns to the parent. */
+    if (g_x > 0 && STATE_OF(piece) == path[g_x - 1].knight && to == path[g_x - 1].from)
+        return 0;
+
+    /* Make the move on the one board (nothing is looked up, so the hash can lag)... */
+    unsigned long long rank = board->rank;
+    unsigned short h_x = board->h_x;
+    board->rank = next_rank;
+
+    PHASE_BEGIN(heuristic_timer);
+    board->h_x = heuristic_after_move(game, board, piece, from, to);
+    PHASE_END(SOLVER_PHASE_HEURISTIC, heuristic_timer);
+    STAT_ADD(SOLVER_STAT_SUCCESSORS, 1);
+
+    board->square[piece] = to;
+    board->occupied ^= (1U << from) | (1U << to);
+    board->moves_from_start = g_x + 1;
+
+    path[g_x].knight = STATE_OF(piece);
+    path[g_x].from = from;
+    path[g_x].to = to;
+
+    if (ida__search(game, board, bound, next_bound, path)) return 1;
+
+    /* ...and take it back again. */
+    board->square[piece] = from;
+    board->occupied ^= (1U << from) | (1U << to);
+    board->rank = rank;
+    board->h_x = h_x;
+    board->moves_from_start = g_x;
+    return 0;
+}
+
+
+/* IDA*: Depth-first search of every route whose f(x) stays within 'bound'.
+ *  Returns 1 once the goal is reached, with the route in 'path'. Otherwise
+ *  lowers '*next_bound' to the smallest f(x) that went over. */
+static
+int
+ida__search(game_t *game,
+            board_t *board,
+            unsigned int bound,
+            unsigned int *next_bound,
+            solver_move_t *path)
+{
+    unsigned int g_x = board->moves_from_start;
+    unsigned int f_x = g_x + board->h_x;
+
+    if (f_x > bound) {
+        *next_bound = MIN(*next_bound, f_x);
+        return 0;
+    }
+
+    if (board->placement == game->goal_board_state.placement) return 1;
+
+    /* Past the cap every call returns at once, unwinding the search. */
+    if (game->expansions >= IDA_EXPANSION_LIMIT) return 0;
+    ++game->expansions;
+
+    /* The state graph lists the same moves in the same order, ranks included. */
+    if (NULL != game->graph) {
+        const graph_t *graph = game->graph;
+        unsigned int first = graph->offsets[board->rank], last = graph->offsets[board->rank + 1];
+
+        for (unsigned int e = first; e < last; ++e) {
+            unsigned int move = graph->moves[e];
+
+            if (ida__try_move(game, board, bound, next_bound, path,
+                              GRAPH_PIECE(move), GRAPH_FROM(move), GRAPH_TO(move),
+                              graph->targets[e]))
+                return 1;
+        }
+
+        return 0;
+    }
+
+    unsigned int empty = ~board->occupied;
+
+    for (unsigned int from = board->occupied; from; from &= from - 1) {
+        int i = __builtin_ctz(from);
+        int piece = piece_at(board, i);
+
+        for (unsigned int to = empty & game->layout.dest_mask[i]; to; to &= to - 1) {
+            int dest = __builtin_ctz(to);
+
+            PHASE_BEGIN(rank_timer);
+            unsigned long long next_rank = rank_after_move(&game->layout, board, piece, i, dest);
+            PHASE_END(SOLVER_PHASE_MOVES, rank_timer);
+
+            if (ida__try_move(game, board, bound, next_bound, path, piece, i, dest, next_rank))
+                return 1;
+        }
+    }
+
+    return 0;
+}
+
+
+/* IDA*: Deepen the f(x) bound until a route to the goal fits within it.
+ *  Only the board being searched and the route to it are kept in memory. */
+static
+solver_status_t
+ida__solve(game_t *game)
+{
+    debug("\n-- Running IDA* Search for best solution...\n");
+
+    /*
+     * Without a closed list, an unreachable goal would be searched for
+     * forever. goal_reachable() settles it on narrow boards; elsewhere it
+     * only rules out some unreachable goals, so the retrograde table (when
+     * the board is small enough for one) gives the exact answer.
+     */
+    if (!goal_reachable(game)) return SOLVER_NO_SOLUTION;
+
+    unsigned int symmetry;
+    if (!game->layout.narrow && game->layout.state_count <= DENSE_STATE_LIMIT
+            && 0 == retro__prepare(game, &symmetry)
+            && DISTANCE_UNKNOWN == retro__distance(game, game->current_board_state, symmetry))
+        return SOLVER_NO_SOLUTION;
+
+    board_t board = *game->current_board_state;
+    solver_move_t *path = NULL;
+    unsigned int bound = board.h_x;
+
+    for (;;) {
+        solver_move_t *grown = realloc(path, (bound + 1) * sizeof(solver_move_t));
+        if (NULL == grown) {
+            free(path);
+            return SOLVER_OUT_OF_MEMORY;
+        }
+        path = grown;
+
+        unsigned int next_bound = ~0U;
+        debug("\n === Searching with f(x) bound %u ===\n", bound);
+        if (ida__search(game, &board, bound, &next_bound, path)) break;
+
+        /* No route can be longer than the number of states, so past that
+         * the goal was out of reach after all. And past the expansion cap,
+         * the search gives up rather than run on for hours. */
+        if (next_bound >= game->layout.state_count || game->expansions >= IDA_EXPANSION_LIMIT) {
+            free(path);
+            return SOLVER_NO_SOLUTION;
+        }
+
+        bound = next_bound;
+    }
+
+    /* Replay the route as a chain of nodes, as the other searches leave it. */
+    for (unsigned int m = 0; m < board.moves_from_start; ++m) {
+        board_t *current_state = game->current_board_state;
+        board_t *next_state = spawn_successor(game, current_state,
+                                              PIECE_OF(path[m].knight),
+                                              path[m].from,
+                                              path[m].to);
+        if (NULL == next_state) {
+            free(path);
+            return SOLVER_OUT_OF_MEMORY;
+        }
+
+        game->current_board_state = next_state;
+    }
+
+    free(path);
+    return SOLVER_OK;
+}
+
+
+/* A*: Expand the cheapest-looking board until the goal is selected. */
+static
+solver_status_t
+astar__solve(game_t *game)
+{
+    expand_fn expand = expand__select(game, POLICY_ASTAR);
+
+    debug("\n-- Running A* Search for best solution...\n");
+    while (0 != check_game(game)) {
+        /* Increase the counter of times we've expanded tree nodes. */
+        ++game->expansions;
+
+        /* Add the next set of moves to the search list. */
+        if (0 != expand(game)) return SOLVER_OUT_OF_MEMORY;
+
+        /*
+         * Select the lowest-cost path according to the set of expanded moves,
+         * and track it (and its symmetric twins) as 'visited'. An open list
+         * without a rank index can hold a board more than once; every copy
+         * after the cheapest is already visited when it comes up, and skipped.
+         */
+        queue_object_t queue_obj;
+        board_t scratch;
+        int fresh;
+        do {
+            PHASE_BEGIN(queue_timer);
+            queue_obj = queue__get_min(game->priority_queue);
+            PHASE_END(SOLVER_PHASE_QUEUE, queue_timer);
+            if (NULL == queue_obj.item) return SOLVER_NO_SOLUTION;
+            STAT_ADD(SOLVER_STAT_POPS, 1);
+
+            PHASE_BEGIN(hash_timer);
+            fresh = hashset__insert(game->visited_boards,
+                                    get_state_code(board_class(game, queue_obj.item, &scratch)));
+            PHASE_END(SOLVER_PHASE_HASH, hash_timer);
+            if (fresh < 0) return SOLVER_OUT_OF_MEMORY;
+        } while (0 == fresh);
+
+        /* Set the current board state to the plucked entry. */
+        game->current_board_state = queue_obj.item;
+        TRACE(game->trace, TRACE_SELECT, 0, game->current_board_state,
+              queue_obj.F, queue_obj.G, queue_obj.H, 0);
+    }
+
+    return SOLVER_OK;
+}
+
+
+/* Branch & Bound: Expand the shortest route so far until the goal is selected.
+ *  No extended list filtering. Exhaustive. */
+static
+solver_status_t
+bnb__solve(game_t *game)
+{
+    expand_fn expand = expand__select(game, POLICY_BNB);
+
+    while (0 != check_game(game)) {
+        /* Increase the counter of times we've expanded tree nodes. */
+        ++game->expansions;
+
+        /* Add the next set of moves to the search list. */
+        if (0 != expand(game)) return SOLVER_OUT_OF_MEMORY;
+
+        /* Select the lowest-cost path according to the set of expanded moves. */
+        PHASE_BEGIN(queue_timer);
+        queue_object_t queue_obj = queue__get_min(game->priority_queue);
+        PHASE_END(SOLVER_PHASE_QUEUE, queue_timer);
+        if (NULL == queue_obj.item) return SOLVER_NO_SOLUTION;
+        STAT_ADD(SOLVER_STAT_POPS, 1);
+
+        /* Set the current board state to the plucked entry. */
+        game->current_board_state = queue_obj.item;
+        TRACE(game->trace, TRACE_SELECT, 0, game->current_board_state,
+              queue_obj.F, queue_obj.G, queue_obj.H, 0);
+    }
+
+    return SOLVER_OK;
+}
+
+/* Copy the route that ends at the current board into the solver's move buffer. */
+solver_status_t
+record_solution(game_t *game,
+                solver_result_t *result)
+{
+    unsigned int count = game->current_board_state->moves_from_start;
+
+    if (count > game->move_capacity) {
+        solver_move_t *moves = realloc(game->moves, count * sizeof(solver_move_t));
+        if (NULL == moves) return SOLVER_OUT_OF_MEMORY;
+
+        game->moves = moves;
+        game->move_capacity = count;
+    }
+
+    /* Walk back to the start; each step differs from its parent by one knight. */
+    board_t *board = game->current_board_state;
+    for (unsigned int m = count; m > 0; --m) {
+        board_t *parent = arena__at(game->nodes, board->parent_index);
+
+        int piece = 0;
+        while (board->square[piece] == parent->square[piece]) ++piece;
+
+        game->moves[m - 1].knight = STATE_OF(piece);
+        game->moves[m - 1].from = parent->square[piece];
+        game->moves[m - 1].to = board->square[piece];
+        board = parent;
+    }
+
+    result->moves = game->moves;
+    result->move_count = count;
+    return SOLVER_OK;
+}
+
+
+solver_t *
+solver__create(queue_kind_t queue_kind)
+{
+    const solver_board_t classic = { 3, 3, 2 };
+    return solver__create_board(&classic, queue_kind);
+}
+
+
+solver_t *
+solver__create_board(const solver_board_t *board,
+                     queue_kind_t queue_kind)
+{
+    game_t *game = calloc(1, sizeof(game_t));
+    if (NULL == game) return NULL;
+
+    if (0 != build_layout(&game->layout, board->rows, board->columns, board->knights_per_side)) {
+        free(game);
+        return NULL;
+    }
+
+#ifdef FN_STATS
+    game->stats = aligned_alloc(64, sizeof(stats_block_t));
+    if (NULL == game->stats) {
+        free(game);
+        return NULL;
+    }
+#endif
+
+    game->queue_kind = queue_kind;
+    game->threads = 1;
+    game->anytime.weight = 3 * ARA_WEIGHT_SCALE;
+    game->node_budget = 1U << 16;
+    return game;
+}
+
+
+solver_t *
+solver__create_like(const solver_t *prototype)
+{
+    const game_t *model = prototype;
+    const solver_board_t board = {
+        model->layout.rows, model->layout.columns, model->layout.knights_per_side
+    };
+
+    game_t *game = solver__create_board(&board, model->queue_kind);
+    if (NULL == game) return NULL;
+
+    /* The pattern databases are built per solver, for each goal. */
+    if (0 != pattern__configure(game, model->patterns.knights)) {
+        solver__destroy(&game);
+        return NULL;
+    }
+
+    game->graph = model->graph;
+    game->threads = model->threads;
+    game->anytime = model->anytime;
+    game->node_budget = model->node_budget;
+    return game;
+}
+
+
+void
+solver__destroy(solver_t **solver)
+{
+    if (NULL == solver || NULL == *solver) return;
+
+    game_t *game = *solver;
+    arena__destroy(&game->nodes);
+    list__destroy(&game->solution_path, 0);
+    hashset__destroy(&game->visited_boards);
+    queue__destroy(&game->priority_queue);
+    queue__destroy(&game->reverse_queue);
+    arena__destroy(&game->reverse_nodes);
+    free(game->goal_distances);
+    pattern__release(game);
+    hda__release(game);
+#ifdef FN_STATS
+    free(game->stats);
+#endif
+#ifdef FN_TRACE
+    trace__close(&game->trace);
+#endif
+    free(game->moves);
+    free(game);
+    *solver = NULL;
+}
+
+
+int
+solver__use_graph(solver_t *solver,
+                  const solver_graph_t *graph)
+{
+    game_t *game = solver;
+
+    if (NULL != graph && (graph->rows != game->layout.rows
+                          || graph->columns != game->layout.columns
+                          || graph->knights_per_side != game->layout.knights_per_side))
+        return 1;
+
+    game->graph = graph;
+    return 0;
+}
+
+
+int
+solver__set_pattern_groups(solver_t *solver,
+                           unsigned int knights)
+{
+    return pattern__configure(solver, knights);
+}
+
+
+void
+solver__set_threads(solver_t *solver,
+                    unsigned int threads)
+{
+    solver->threads = threads ? threads : 1;
+}
+
+
+void
+solver__set_anytime(solver_t *solver,
+                    double weight,
+                    unsigned long long budget_us,
+                    solver_solution_fn on_solution,
+                    void *context)
+{
+    anytime_t *anytime = &solver->anytime;
+
+    /* Rounded up, and capped where the keys would spread the bucket queue too thin. */
+    anytime->weight = ARA_WEIGHT_SCALE;
+    while (anytime->weight < weight * ARA_WEIGHT_SCALE && anytime->weight < ARA_MAX_WEIGHT * ARA_WEIGHT_SCALE)
+        ++anytime->weight;
+    anytime->budget_ns = budget_us * 1000;
+    anytime->on_solution = on_solution;
+    anytime->context = context;
+}
+
+
+void
+solver__set_memory_limit(solver_t *solver,
+                         unsigned int nodes)
+{
+    solver->node_budget = MAX(nodes, 2);
+}
+
+
+int
+solver__set_trace(solver_t *solver,
+                  const char *path)
+{
+#ifdef FN_TRACE
+    game_t *game = solver;
+    const solver_board_t board = {
+        game->layout.rows, game->layout.columns, game->layout.knights_per_side
+    };
+
+    trace__close(&game->trace);
+    if (NULL == path) return 0;
+
+    game->trace = trace__open(path, &board);
+    return NULL == game->trace;
+#else
+    (void)solver;
+    return NULL != path;
+#endif
+}
+
+
+#ifdef FN_TRACE
+/* Log how a solve ended, and the boards of its route if it found one. */
+static
+void
+trace_outcome(game_t *game,
+              solver_status_t status,
+              const solver_result_t *result)
+{
+    board_t board = game->initial_board_state;
+
+    trace__record(game->trace, TRACE_END, 0, board.placement, board.hash,
+                  0, result->move_count, 0, status);
+    if (SOLVER_OK != status) return;
+
+    TRACE(game->trace, TRACE_ROUTE, 0, &board, 0, 0, 0, 0);
+    for (unsigned int m = 0; m < result->move_count; ++m) {
+        const solver_move_t *move = &result->moves[m];
+        int piece = PIECE_OF(move->knight);
+
+        board.square[piece] = move->to;
+        board.hash ^= game->layout.zobrist_key[move->from][piece]
+                    ^ game->layout.zobrist_key[move->to][piece];
+        TRACE(game->trace, TRACE_ROUTE, 0, &board, 0, m + 1, 0, m + 1);
+    }
+}
+#endif
+
+
+/* Run one search from scratch and record its route. */
+static
+solver_status_t
+run_search(game_t *game,
+           solver_algorithm_t algorithm,
+           const board_space_state_t *start,
+           const board_space_state_t *goal,
+           solver_result_t *result)
+{
+    solver_status_t status;
+
+    if (0 != pack_board(&game->layout, &game->initial_board_state, start) ||
+            0 != pack_board(&game->layout, &game->goal_board_state, goal))
+        return SOLVER_INVALID_BOARD;
+
+    /* A retrograde query only walks the goal's distance table, so it needs
+     * none of the open list, closed set, symmetries or heuristic a search
+     * sets up; rewinding the node arena is enough. */
+    debug("\n-- Initializing game board...\n");
+    if (0 != (SOLVER_RETRO == algorithm ? rewind_game(game) : reset_game(game)))
+        return SOLVER_OUT_OF_MEMORY;
+    print_board(&game->layout, game->current_board_state);
+    debug( "\n-- Game goal state...\n");
+    print_board(&game->layout, &game->goal_board_state);
+
+#ifdef FN_TRACE
+    if (NULL != game->trace)
+        trace__record(game->trace, TRACE_BEGIN, algorithm,
+                      game->initial_board_state.placement, game->goal_board_state.placement,
+                      game->current_board_state->h_x, 0, game->current_board_state->h_x, 0);
+#endif
+
+    switch (algorithm) {
+        case SOLVER_ASTAR:      status = astar__solve(game);   break;
+        case SOLVER_BNB:        status = bnb__solve(game);     break;
+        case SOLVER_RETRO:      status = retro__solve(game);   break;
+        case SOLVER_HDA:        status = hda__solve(game);     break;
+        case SOLVER_IDA:        status = ida__solve(game);     break;
+        case SOLVER_BIDI:       status = bidi__solve(game, 0); break;
+        case SOLVER_BIDI_ASTAR: status = bidi__solve(game, 1); break;
+        case SOLVER_ARA:        status = ara__solve(game, result); break;
+        case SOLVER_SMA:        status = sma__solve(game);     break;
+        default:                status = SOLVER_NO_SOLUTION;   break;
+    }
+
+    result->expansions = game->expansions;
+    result->nodes = game->nodes->used + game->other_nodes;
+
+#ifdef FN_DEBUG
+    if (SOLVER_OK == status) print_final_game_solution(game);
+#endif
+
+    if (SOLVER_OK == status) status = record_solution(game, result);
+
+#ifdef FN_TRACE
+    if (NULL != game->trace) trace_outcome(game, status, result);
+#endif
+
+    return status;
+}
+
+
+solver_status_t
+solver__solve(solver_t *solver,
+              solver_algorithm_t algorithm,
+              const board_space_state_t *start,
+              const board_space_state_t *goal,
+              solver_result_t *result)
+{
+    game_t *game = solver;
+
+    result->moves = NULL;
+    result->move_count = 0;
+    result->expansions = 0;
+    result->nodes = 0;
+    result->bound = 1.0;
+
+#ifdef FN_STATS
+    /* Everything the solve does on this thread counts toward the solver. */
+    memset(game->stats, 0, sizeof(stats_block_t));
+    stats_block_t *previous = stats__bind(game->stats);
+    solver_status_t status = run_search(game, algorithm, start, goal, result);
+    stats__bind(previous);
+
+    result->stats = game->stats->values;
+    return status;
+#else
+    memset(&result->stats, 0, sizeof(solver_stats_t));
+    return run_search(game, algorithm, start, goal, result);
+#endif
+}
+
+
+const char *
+solver__status_message(solver_status_t status)
+{
+    switch (status) {
+        case SOLVER_OK:            return "Solved.";
+        case SOLVER_INVALID_BOARD: return "The start or goal board is not a legal Four Knights position.";
+        case SOLVER_NO_SOLUTION:   return "Uh oh! Looks like there are no more possibilities.";
+        case SOLVER_OUT_OF_MEMORY: return "The search ran out of room for its open list or nodes.";
+        case SOLVER_TIMED_OUT:     return "The time budget ran out before any route was found.";
+    }
+
+    return "Unknown solver status.";
+}
@@ -0,0 +1,41 @@
+/*
+ * stats.c
+ *
+ *  Thread binding and merging of instrumentation blocks (see stats.h).
+ */
+
+#include "stats.h"
+
+
+#ifdef FN_STATS
+
+_Thread_local stats_block_t *stats__current = NULL;
+
+
+stats_block_t *
+stats__bind(stats_block_t *block)
+{
+    stats_block_t *previous = stats__current;
+    stats__current = block;
+    return previous;
+}
+
+
+void
+stats__merge(solver_stats_t *into,
+             const solver_stats_t *from)
+{
+    for (unsigned int s = 0; s < SOLVER_STAT_COUNT; ++s) {
+        if (SOLVER_STAT_OPEN_PEAK == s)
+            into->counter[s] = from->counter[s] > into->counter[s] ? from->counter[s] : into->counter[s];
+        else
+            into->counter[s] += from->counter[s];
+    }
+
+    for (unsigned int p = 0; p < SOLVER_PHASE_COUNT; ++p) {
+        into->cycles[p] += from->cycles[p];
+        into->calls[p] += from->calls[p];
+    }
+}
+
+#endif   /* FN_STATS */
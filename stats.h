@@ -0,0 +1,94 @@
+/*
+ * stats.h
+ *
+ *  Instrumentation of the search hot paths: event counters and phase
+ *  timers, compiled in only when FN_STATS is defined ('make stats').
+ *  Otherwise every macro here expands to nothing.
+ *
+ *  A solver owns one block of counters, and each HDA* worker thread
+ *  another, merged into its solver's at the end. Blocks are padded to
+ *  whole cache lines so threads never share one. Code records into the
+ *  block bound to the running thread, which lets the queues and
+ *  allocators count without being handed a solver. solver__solve() binds
+ *  the solver's block for the length of the solve.
+ *
+ *  Phase timers read the time-stamp counter on x86 (cycles) and the
+ *  monotonic clock elsewhere (nanoseconds). Reading either costs about as
+ *  much as the smallest phases it brackets, so compare phases within an
+ *  instrumented build, not against timings of a plain one.
+ */
+
+#ifndef FOURKNIGHTS_STATS_H
+#define FOURKNIGHTS_STATS_H
+
+#include "fourknights.h"
+
+
+#ifdef FN_STATS
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#else
+#include <time.h>
+#endif
+
+typedef struct
+{
+    _Alignas(64) solver_stats_t values;
+} stats_block_t;
+
+/* The block the running thread records into. */
+extern _Thread_local stats_block_t *stats__current;
+
+/* Bind a block to the running thread, returning the one it replaces. */
+stats_block_t *
+stats__bind(
+    stats_block_t *block
+);
+
+/* Add one block's counts into another's (peaks take the larger). */
+void
+stats__merge(
+    solver_stats_t *into,
+    const solver_stats_t *from
+);
+
+static inline
+unsigned long long
+stats__clock(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1000000000ULL + now.tv_nsec;
+#endif
+}
+
+#define STAT_ADD(stat, n) \
+    (stats__current->values.counter[stat] += (n))
+#define STAT_PEAK(stat, n) \
+    do { \
+        unsigned long long peak_ = (n); \
+        if (peak_ > stats__current->values.counter[stat]) stats__current->values.counter[stat] = peak_; \
+    } while (0)
+#define PHASE_BEGIN(timer) \
+    unsigned long long timer = stats__clock()
+#define PHASE_END(phase, timer) \
+    do { \
+        stats__current->values.cycles[phase] += stats__clock() - (timer); \
+        ++stats__current->values.calls[phase]; \
+    } while (0)
+
+#else
+
+#define STAT_ADD(stat, n)        ((void)0)
+#define STAT_PEAK(stat, n)       ((void)0)
+#define PHASE_BEGIN(timer)       ((void)0)
+#define PHASE_END(phase, timer)  ((void)0)
+
+#endif   /* FN_STATS */
+
+
+#endif   /* FOURKNIGHTS_STATS_H */
@@ -0,0 +1,117 @@
+/*
+ * trace.c
+ *
+ *  The trace ring's writer thread and its file (see trace.h).
+ */
+
+#include "trace.h"
+
+
+#ifdef FN_TRACE
+
+#include <sched.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+
+/* Writer thread: append records to the file as they arrive, until the
+ *  trace is closing and the ring is empty. */
+static
+void *
+write_records(void *arg)
+{
+    trace_t *trace = arg;
+    const struct timespec idle = { 0, 200 * 1000 };
+
+    for (;;) {
+        /* Read before 'head', so once closing is seen every record is too. */
+        int stopping = atomic_load_explicit(&trace->stopping, memory_order_acquire);
+        unsigned long long head = atomic_load_explicit(&trace->head, memory_order_acquire);
+        unsigned long long tail = atomic_load_explicit(&trace->tail, memory_order_relaxed);
+
+        if (head == tail) {
+            if (stopping) break;
+            nanosleep(&idle, NULL);
+            continue;
+        }
+
+        /* As many as there are up to the ring's end, in one write. A failed
+         * write still frees the records, so the producer never stalls. */
+        unsigned long long first = tail & (TRACE_RING_RECORDS - 1);
+        unsigned long long count = head - tail;
+        if (count > TRACE_RING_RECORDS - first) count = TRACE_RING_RECORDS - first;
+
+        fwrite(&trace->records[first], sizeof(trace_record_t), count, trace->file);
+        atomic_store_explicit(&trace->tail, tail + count, memory_order_release);
+    }
+
+    return NULL;
+}
+
+
+trace_t *
+trace__open(const char *path,
+            const solver_board_t *board)
+{
+    trace_t *trace = aligned_alloc(64, sizeof(trace_t));
+    if (NULL == trace) return NULL;
+
+    trace->records = malloc(TRACE_RING_RECORDS * sizeof(trace_record_t));
+    trace->file = fopen(path, "wb");
+    if (NULL == trace->records || NULL == trace->file) goto failed;
+
+    trace_header_t header = {
+        .rows = board->rows,
+        .columns = board->columns,
+        .knights_per_side = board->knights_per_side,
+        .record_size = sizeof(trace_record_t),
+    };
+    memcpy(header.magic, TRACE_MAGIC, sizeof(header.magic));
+    if (1 != fwrite(&header, sizeof(header), 1, trace->file)) goto failed;
+
+    atomic_init(&trace->head, 0);
+    atomic_init(&trace->tail, 0);
+    atomic_init(&trace->stopping, 0);
+    trace->room_until = TRACE_RING_RECORDS;
+
+    if (0 != pthread_create(&trace->writer, NULL, write_records, trace)) goto failed;
+    return trace;
+
+failed:
+    if (NULL != trace->file) fclose(trace->file);
+    free(trace->records);
+    free(trace);
+    return NULL;
+}
+
+
+void
+trace__close(trace_t **trace)
+{
+    if (NULL == trace || NULL == *trace) return;
+
+    atomic_store_explicit(&(*trace)->stopping, 1, memory_order_release);
+    pthread_join((*trace)->writer, NULL);
+
+    fclose((*trace)->file);
+    free((*trace)->records);
+    free(*trace);
+    *trace = NULL;
+}
+
+
+/* Producer only. */
+void
+trace__wait(trace_t *trace,
+            unsigned long long head)
+{
+    unsigned long long tail;
+
+    while (head - (tail = atomic_load_explicit(&trace->tail, memory_order_acquire)) >= TRACE_RING_RECORDS)
+        sched_yield();
+
+    trace->room_until = tail + TRACE_RING_RECORDS;
+}
+
+#endif   /* FN_TRACE */
@@ -0,0 +1,153 @@
+/*
+ * trace.h
+ *
+ *  Binary event tracing of the A* and branch and bound hot paths,
+ *  compiled in only when FN_TRACE is defined ('make trace'). Otherwise
+ *  every macro here expands to nothing.
+ *
+ *  Each event is one fixed-size record: what happened, the packed board,
+ *  its f/g/h and its state code. Records go into a preallocated ring
+ *  with a single producer, the solving thread, and a single consumer, a
+ *  background thread that appends them to the trace file. Recording one
+ *  is a handful of stores and a release; the producer only ever waits
+ *  when the writer has fallen a whole ring behind.
+ *
+ *  A trace file is a trace_header_t followed by records, and is rendered
+ *  as text by the fourknights-trace tool (tracedump.c).
+ */
+
+#ifndef FOURKNIGHTS_TRACE_H
+#define FOURKNIGHTS_TRACE_H
+
+#include "fourknights.h"
+
+
+#define TRACE_MAGIC         "FNTRACE1"
+
+/* Records a ring holds: a power of two, 1 MiB of them. */
+#define TRACE_RING_RECORDS  (1U << 15)
+
+typedef enum
+{
+    TRACE_BEGIN = 0,     /* A solve starts: the start board; 'code' is the goal's placement, 'flags' the solver_algorithm_t. */
+    TRACE_EXPAND,        /* A board's successors are about to be generated. */
+    TRACE_GENERATE,      /* A successor was queued. */
+    TRACE_REJECT,        /* A successor was dropped as a duplicate. */
+    TRACE_SELECT,        /* A board was taken off the open list. */
+    TRACE_ROUTE,         /* One board of the solution, start first; 'extra' is its step. */
+    TRACE_END            /* A solve ended: 'extra' is its solver_status_t, 'g' the route's length. */
+} trace_event_t;
+
+/* TRACE_GENERATE and TRACE_REJECT flags. */
+#define TRACE_ASTAR         0x01    /* Recorded by A*, so 'code' went into the closed set. */
+#define TRACE_UPDATED       0x02    /* Replaced a costlier open-list entry, whose g(x) is 'extra'. */
+#define TRACE_QUEUED        0x04    /* Rejected for an open-list entry at least as cheap. */
+
+typedef struct
+{
+    unsigned char       event;       /* trace_event_t */
+    unsigned char       flags;
+    unsigned short      f;
+    unsigned short      g;
+    unsigned short      h;
+    unsigned long long  placement;   /* The board's knight squares, packed as in board_t. */
+    unsigned long long  code;        /* The board's state code (its Zobrist hash). */
+    unsigned long long  extra;
+} trace_record_t;
+
+typedef struct
+{
+    char                magic[8];
+    unsigned int        rows;
+    unsigned int        columns;
+    unsigned int        knights_per_side;
+    unsigned int        record_size;
+} trace_header_t;
+
+
+#ifdef FN_TRACE
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+
+/*
+ * The ring's two ends sit on separate cache lines. 'head' is only
+ * written by the producer and 'tail' only by the writer thread; the
+ * producer keeps its last look at 'tail' so it rarely has to load it.
+ */
+typedef struct
+{
+    _Alignas(64) _Atomic unsigned long long head;
+    unsigned long long  room_until;
+    trace_record_t     *records;
+    _Alignas(64) _Atomic unsigned long long tail;
+    _Atomic int         stopping;
+    FILE               *file;
+    pthread_t           writer;
+} trace_t;
+
+
+/* Create the trace file, write its header and start its writer thread.
+ *  Returns NULL if the file or the ring can't be made. */
+trace_t *
+trace__open(
+    const char *path,
+    const solver_board_t *board
+);
+
+/* Write out every record still in the ring, and close the file. */
+void
+trace__close(
+    trace_t **trace
+);
+
+/* Wait for the writer to make room in a full ring. */
+void
+trace__wait(
+    trace_t *trace,
+    unsigned long long head
+);
+
+static inline
+void
+trace__record(trace_t *trace,
+              trace_event_t event,
+              unsigned int flags,
+              unsigned long long placement,
+              unsigned long long code,
+              unsigned int f,
+              unsigned int g,
+              unsigned int h,
+              unsigned long long extra)
+{
+    unsigned long long head = atomic_load_explicit(&trace->head, memory_order_relaxed);
+    if (head == trace->room_until) trace__wait(trace, head);
+
+    trace_record_t *record = &trace->records[head & (TRACE_RING_RECORDS - 1)];
+    record->event = event;
+    record->flags = flags;
+    record->f = f;
+    record->g = g;
+    record->h = h;
+    record->placement = placement;
+    record->code = code;
+    record->extra = extra;
+
+    atomic_store_explicit(&trace->head, head + 1, memory_order_release);
+}
+
+#define TRACE(trace, event, flags, board, f, g, h, extra) \
+    do { \
+        if (NULL != (trace)) \
+            trace__record((trace), (event), (flags), (board)->placement, (board)->hash, (f), (g), (h), (extra)); \
+    } while (0)
+
+#else
+
+#define TRACE(trace, event, flags, board, f, g, h, extra)  ((void)0)
+
+#endif   /* FN_TRACE */
+
+
+#endif   /* FOURKNIGHTS_TRACE_H */
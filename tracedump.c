@@ -0,0 +1,178 @@
+/*
+ * tracedump.c
+ *
+ *  Decoder for the binary traces of a 'make trace' build (see trace.h).
+ *
+ *  Renders a trace as the text the -print builds used to write while
+ *  searching: each board discovered and selected, and the route found.
+ *  With -v, it also shows the events that text never had: every
+ *  expansion, and every successor dropped as a duplicate.
+ */
+
+#include "trace.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+
+/* Print command-line usage. */
+static
+void
+usage(const char *program)
+{
+    fprintf(stderr, "Usage: %s [-v] trace-file\n", program);
+    fprintf(stderr, "  -v    Also show expansions and rejected successors.\n");
+}
+
+
+/* Print a packed board as print_board() does. */
+static
+void
+print_board(const solver_board_t *board,
+            unsigned long long placement)
+{
+    unsigned int squares = board->rows * board->columns;
+    unsigned char square[MAX_KNIGHTS];
+    char spaces[MAX_BOARD_SQUARES];
+
+    memcpy(square, &placement, sizeof(square));
+    memset(spaces, '.', squares);
+    for (unsigned int p = 0; p < 2 * board->knights_per_side; ++p)
+        spaces[square[p]] = solver__knight_glyph(board, (board_space_state_t)(p + 1));
+
+    for (unsigned int i = 0; i < squares; ++i) {
+        putchar(spaces[i]);
+        if (!((i + 1) % board->columns)) putchar('\n');
+    }
+}
+
+
+static
+void
+print_record(const solver_board_t *board,
+             const trace_record_t *record,
+             int verbose)
+{
+    switch ((trace_event_t)record->event) {
+        case TRACE_BEGIN:
+            printf("\n-- Initializing game board...\n");
+            print_board(board, record->placement);
+            printf("\n-- Game goal state...\n");
+            print_board(board, record->code);
+
+            if (SOLVER_ASTAR == record->flags) printf("\n-- Running A* Search for best solution...\n");
+            break;
+
+        case TRACE_EXPAND:
+            if (!verbose) break;
+            printf("\nExpanding (expansion %llu):\n", record->extra + 1);
+            print_board(board, record->placement);
+            printf("Stats:\tf(x) = %u\tg(x) = %u\th(x) = %u\n", record->f, record->g, record->h);
+            break;
+
+        case TRACE_GENERATE:
+            printf("\nDiscovered new possible move:\n");
+            print_board(board, record->placement);
+            printf("Stats:\tf(x) = %u\tg(x) = %u\th(x) = %u\n", record->f, record->g, record->h);
+
+            if (record->flags & TRACE_ASTAR)
+                printf("\tUnseen board hash recorded: %016llx\n", record->code);
+            if (record->flags & TRACE_UPDATED)
+                printf("\tCheaper than the queued path (g(x) = %llu); updated it.\n", record->extra);
+            break;
+
+        case TRACE_REJECT:
+            if (!verbose) break;
+            printf("\nRejected possible move:\n");
+            print_board(board, record->placement);
+
+            if (record->flags & TRACE_QUEUED)
+                printf("\tAlready queued with g(x) = %llu, against %u here.\n", record->extra, record->g);
+            else
+                printf("\tAlready visited (hash %016llx).\n", record->code);
+            break;
+
+        case TRACE_SELECT:
+            printf("\n === Selected Route w/ Cost %d ===\n", record->f);
+            print_board(board, record->placement);
+            break;
+
+        case TRACE_ROUTE:
+            print_board(board, record->placement);
+            printf("\n");
+            break;
+
+        case TRACE_END:
+            if (SOLVER_OK == record->extra)
+                printf("\n\n\n========================================\nFinal game route (%u steps):\n",
+                       record->g);
+            else
+                printf("\n-- The search ended: %s\n", solver__status_message((solver_status_t)record->extra));
+            break;
+
+        default:
+            printf("\n-- Unknown trace event %u.\n", record->event);
+            break;
+    }
+}
+
+
+int
+main(int argc,
+     char **argv)
+{
+    int verbose = 0;
+    int opt;
+    while (-1 != (opt = getopt(argc, argv, "v"))) {
+        switch (opt) {
+            case 'v':
+                verbose = 1;
+                break;
+            default:
+                usage(argv[0]);
+                return 1;
+        }
+    }
+
+    if (optind + 1 != argc) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    const char *path = argv[optind];
+    FILE *file = fopen(path, "rb");
+    if (NULL == file) {
+        fprintf(stderr, "Cannot open '%s'.\n", path);
+        return 1;
+    }
+
+    trace_header_t header;
+    if (1 != fread(&header, sizeof(header), 1, file)
+            || 0 != memcmp(header.magic, TRACE_MAGIC, sizeof(header.magic))
+            || sizeof(trace_record_t) != header.record_size
+            || header.rows * header.columns > MAX_BOARD_SQUARES
+            || 2 * header.knights_per_side > MAX_KNIGHTS) {
+        fprintf(stderr, "%s: not a trace from this version of the solver.\n", path);
+        fclose(file);
+        return 1;
+    }
+
+    const solver_board_t board = { header.rows, header.columns, header.knights_per_side };
+    trace_record_t records[256];
+    size_t count;
+
+    while (0 != (count = fread(records, sizeof(trace_record_t), 256, file)))
+        for (size_t r = 0; r < count; ++r)
+            print_record(&board, &records[r], verbose);
+
+    int failed = ferror(file);
+    fclose(file);
+
+    if (failed) {
+        fprintf(stderr, "Failed to read '%s'.\n", path);
+        return 1;
+    }
+
+    return 0;
+}